@@ -0,0 +1,358 @@
+#include <benchmark/benchmark.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "attacks.h"
+#include "basics.h"
+#include "engine.h"
+#include "game.h"
+#include "move.h"
+#include "pieces.h"
+#include "solver.h"
+
+// Positions used throughout (same 64-character format as `Game(const std::string &)`):
+
+const std::string kStartPosition = "rnbqkbnrpppppppp                                PPPPPPPPRNBQKBNR";
+
+const std::vector<std::string> kMiddlegames = {
+    "r  q rk pp  bppp  n pn     p    B P     P NP    P   QPPPR    RK ",  // open centre
+    "r bq rk ppp  ppp  np n    p     B P b   P N  N  PPP  PPPR BQK  R",   // italian-like
+    "     rk  p   ppppq   b                   P Q N  P    PPP   r K  ",  // rook check (from tests)
+};
+
+const std::string kMatePosition = "r  r  k   q bpQ    p   p ppn     P BP   P           RPPPR     K ";
+const std::string kNoMatePosition = "rn  kbnrpppPpppp                                PPP PPPPRNBQKBNR";
+
+// swallows everything, used to time rendering without a terminal:
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+// Game setup
+
+static void BM_GameFromString(benchmark::State &state) {
+  for (auto _ : state) {
+    Game game(kStartPosition);
+    benchmark::DoNotOptimize(game);
+  }
+}
+BENCHMARK(BM_GameFromString);
+
+// Everything a fresh `bin/chess` does up to its first move, minus process
+// start-up: set up, show the board, read, check & make the move, show again
+
+static void BM_TimeToFirstMove(benchmark::State &state) {
+  NullBuffer null_buffer;
+  auto *original = std::cout.rdbuf(&null_buffer);
+  Game::set_script_mode(true);
+
+  for (auto _ : state) {
+    auto game = std::make_shared<Game>();
+    auto movemaker = std::make_shared<MoveFactory>();
+    game->show();
+
+    const std::string input = "Pe2e4";
+    if (movemaker->valid(input)) {
+      auto move = movemaker->parse_move(input);
+      if (game->try_move(move)) {
+        game->make_move(move);
+        game->swap();
+        benchmark::DoNotOptimize(game->checkmate(game->to_move()));
+        game->show();
+      }
+    }
+  }
+
+  Game::set_script_mode(false);
+  std::cout.rdbuf(original);
+}
+BENCHMARK(BM_TimeToFirstMove)->Unit(benchmark::kMicrosecond);
+
+// Making & reverting moves
+
+static void BM_MakeUndo(benchmark::State &state) {
+  Game game;
+  MoveFactory movemaker;
+  auto move = movemaker.parse_move("Pe2e4");
+
+  for (auto _ : state) {
+    game.make_move(move);
+    game.undo();
+  }
+}
+BENCHMARK(BM_MakeUndo);
+
+// Forking a game deep into its history (shares the history, copies one board)
+
+static void BM_Fork(benchmark::State &state) {
+  Game game;
+  for (int ply = 0; ply < state.range(0); ++ply) {
+    auto moves = game.legal_moves();
+    if (moves.empty()) break;
+    game.make_move(moves[ply % moves.size()]);
+    game.swap();
+  }
+
+  for (auto _ : state) {
+    Game variation = game.fork(game.ply() / 2);
+    benchmark::DoNotOptimize(variation);
+  }
+}
+BENCHMARK(BM_Fork)->Arg(10)->Arg(100);
+
+// Check detection
+
+static void BM_InCheck(benchmark::State &state) {
+  Game game(kMiddlegames[state.range(0)]);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game.in_check(Player::White));
+    benchmark::DoNotOptimize(game.in_check(Player::Black));
+  }
+}
+BENCHMARK(BM_InCheck)->DenseRange(0, 2);
+
+// Attack maps: one pass over the board with bitboards, next to the scalar way of
+// asking every piece of the side whether it could capture on each square
+
+static Bitboard scalar_attacks(const Game &game, Player by) {
+  Board board = game.board();
+  Bitboard attacked = 0;
+
+  for (int r = 0; r < 8; ++r) {
+    for (int c = 0; c < 8; ++c) {
+      for (int row = 0; row < 8; ++row) {
+        for (int col = 0; col < 8; ++col) {
+          auto piece = board[row][col];
+          if (!piece || piece->owner() != by || (row == r && col == c)) continue;
+
+          // `Pawn::valid` only captures onto occupied squares, so pawns are done by hand:
+          bool attacks;
+          if (std::tolower(piece->to_char()) == 'p')
+            attacks = std::abs(c - col) == 1 && r - row == (by == Player::White ? -1 : 1);
+          else
+            attacks = piece->valid(Move(piece->to_char(), Field(row, col), Field(r, c), true), board);
+
+          if (attacks) {
+            attacked |= square_bit(Field(r, c));
+            row = col = 8;  // square done
+          }
+        }
+      }
+    }
+  }
+
+  return attacked;
+}
+
+static void BM_AttackMap(benchmark::State &state) {
+  Game game(kMiddlegames[state.range(0)]);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game.attacks(Player::White));
+    benchmark::DoNotOptimize(game.attacks(Player::Black));
+  }
+}
+BENCHMARK(BM_AttackMap)->DenseRange(0, 2);
+
+static void BM_AttackMapScalar(benchmark::State &state) {
+  Game game(kMiddlegames[state.range(0)]);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scalar_attacks(game, Player::White));
+    benchmark::DoNotOptimize(scalar_attacks(game, Player::Black));
+  }
+}
+BENCHMARK(BM_AttackMapScalar)->DenseRange(0, 2);
+
+// Checkmate detection (mate is cheap to refute if not in check, so time both)
+
+static void BM_CheckmateMate(benchmark::State &state) {
+  Game game(kMatePosition);
+  game.swap();
+
+  for (auto _ : state) benchmark::DoNotOptimize(game.checkmate(Player::Black));
+}
+BENCHMARK(BM_CheckmateMate);
+
+static void BM_CheckmateNoMate(benchmark::State &state) {
+  Game game(kNoMatePosition);
+  game.swap();
+
+  for (auto _ : state) benchmark::DoNotOptimize(game.checkmate(Player::Black));
+}
+BENCHMARK(BM_CheckmateNoMate);
+
+// Perft: move generation & make/undo over the whole tree from the start, through the general
+// validator (every candidate checked by `try_move`, i.e. the virtual `Piece::valid`) & through
+// `Game::perft` (the generator templated per side & piece kind, see movegen.h)
+
+static uint64_t perft_dispatch(Game &game, int depth) {
+  if (depth == 0) return 1;
+
+  std::vector<std::shared_ptr<Move>> moves;
+  Board board = game.board();
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      auto piece = board[row][col];
+      if (!piece || piece->owner() != game.to_move()) continue;
+
+      Bitboard to = piece_moves(board, Field(row, col));
+      for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+          if (!(to & square_bit(Field(r, c)))) continue;
+          auto move = std::make_shared<Move>(piece->to_char(), Field(row, col), Field(r, c), board[r][c] != nullptr);
+          if (game.try_move(move)) moves.push_back(move);
+        }
+      }
+    }
+  }
+
+  uint64_t nodes = 0;
+  for (const auto &move : moves) {
+    game.make_move(move);
+    game.swap();
+    nodes += perft_dispatch(game, depth - 1);
+    game.undo();
+    game.swap();
+  }
+  return nodes;
+}
+
+static void BM_Perft(benchmark::State &state) {
+  Game game;
+  uint64_t nodes = 0;
+  for (auto _ : state) nodes = state.range(0) ? game.perft(3) : perft_dispatch(game, 3);
+  state.counters["nodes"] = nodes;
+}
+BENCHMARK(BM_Perft)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Mate solver: a mate in 2 proven (two rooks), and refuted in a middlegame, on one thread
+
+static void BM_MateSolve(benchmark::State &state) {
+  const std::string empty(8, ' ');
+  Game rollers("       k" + empty + "R       " + " R      " + empty + empty + empty + "      K ");
+  Game middlegame(kMiddlegames[0]);
+  Game &game = state.range(0) ? middlegame : rollers;
+
+  for (auto _ : state) benchmark::DoNotOptimize(solve_mate(game, 2, 1));
+}
+BENCHMARK(BM_MateSolve)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Search: nodes visited (the "nodes" counter) & time for one move, with the
+// heuristics switched on one at a time, then all together
+
+const std::vector<std::string> kSearchSpecs = {
+    "depth=4,no-tt,no-mvv,no-killers,no-history,no-null,no-lmr,no-qs",
+    "depth=4,no-mvv,no-killers,no-history,no-null,no-lmr,no-qs",  // tt
+    "depth=4,no-tt,no-killers,no-history,no-null,no-lmr,no-qs",    // mvv
+    "depth=4,no-tt,no-mvv,no-history,no-null,no-lmr,no-qs",        // killers
+    "depth=4,no-tt,no-mvv,no-killers,no-null,no-lmr,no-qs",        // history
+    "depth=4,no-tt,no-mvv,no-killers,no-history,no-lmr,no-qs",     // null
+    "depth=4,no-tt,no-mvv,no-killers,no-history,no-null,no-qs",    // lmr
+    "depth=4,no-qs",
+    "depth=4",
+};
+
+static void BM_Search(benchmark::State &state) {
+  EngineConfig config;
+  EngineConfig::parse(kSearchSpecs[state.range(0)], config);
+  Game game(kMiddlegames[0]);
+  uint64_t nodes = 0;
+
+  for (auto _ : state) {
+    Engine engine(config);
+    benchmark::DoNotOptimize(engine.best_move(game));
+    nodes = engine.nodes();
+  }
+
+  state.counters["nodes"] = nodes;
+  state.SetLabel(config.name());
+}
+BENCHMARK(BM_Search)->DenseRange(0, 8)->Unit(benchmark::kMillisecond);
+
+// Fixed node budget: the same work on every machine & build, so the time is directly comparable
+static void BM_SearchNodes(benchmark::State &state) {
+  EngineConfig config;
+  EngineConfig::parse("depth=64,nodes=" + std::to_string(state.range(0)), config);
+  Game game(kMiddlegames[0]);
+
+  for (auto _ : state) {
+    Engine engine(config);
+    benchmark::DoNotOptimize(engine.best_move(game));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetLabel(config.name());
+}
+BENCHMARK(BM_SearchNodes)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+// Multi-PV analysis of every move: one tree sharing the table between moves (arg 1) vs. no table (arg 0)
+static void BM_Analyze(benchmark::State &state) {
+  EngineConfig config;
+  EngineConfig::parse(state.range(0) ? "depth=3" : "depth=3,no-tt", config);
+  Game game(kMiddlegames[0]);
+  uint64_t nodes = 0;
+
+  for (auto _ : state) {
+    Engine engine(config);
+    benchmark::DoNotOptimize(engine.analyze(game));
+    nodes = engine.nodes();
+  }
+
+  state.counters["nodes"] = nodes;
+  state.SetLabel(config.name());
+}
+BENCHMARK(BM_Analyze)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Input handling
+
+static void BM_MoveFormat(benchmark::State &state) {
+  MoveFactory movemaker;
+
+  for (auto _ : state) benchmark::DoNotOptimize(movemaker.valid("Nf3xd4"));
+}
+BENCHMARK(BM_MoveFormat);
+
+static void BM_ParseMove(benchmark::State &state) {
+  MoveFactory movemaker;
+
+  for (auto _ : state) benchmark::DoNotOptimize(movemaker.parse_move("Pd7d8=Q"));
+}
+BENCHMARK(BM_ParseMove);
+
+// Rendering
+
+static void BM_PrintBoard(benchmark::State &state) {
+  Game game(kMiddlegames[0]);
+  NullBuffer null_buffer;
+  auto *original = std::cout.rdbuf(&null_buffer);
+
+  for (auto _ : state) game.print_board(state.range(0));
+
+  std::cout.rdbuf(original);
+}
+BENCHMARK(BM_PrintBoard)->Arg(0)->Arg(1);
+
+// :m for the king (from the attack map) and a knight (trial moves, checked with the attack map)
+static void BM_PrintMoves(benchmark::State &state) {
+  Game game(kMiddlegames[0]);
+  NullBuffer null_buffer;
+  auto *original = std::cout.rdbuf(&null_buffer);
+  const std::string input = state.range(0) == 0 ? "Kg1" : "Nc3";
+
+  for (auto _ : state) game.print_moves(input, true);
+
+  std::cout.rdbuf(original);
+}
+BENCHMARK(BM_PrintMoves)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
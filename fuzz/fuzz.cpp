@@ -0,0 +1,230 @@
+//===----------------------------------------------------------------------===//
+//
+// Fuzzing harness. `LLVMFuzzerTestOneInput` is the libFuzzer entry point;
+// the first byte of an input picks the target, the rest is its data:
+//
+//   0: move input      `MoveFactory::valid`, `parse_move` & `to_string` round trip
+//   1: position        `Game(const std::string &)` (throws on bad input), then
+//                      the legal moves & check status against reference.h
+//   2: move sequence   a game played by the bytes: each one picks a legal
+//                      move, takes one back or detonates (Beirut variant);
+//                      the board must always match a game rebuilt from its
+//                      position & undoing everything must restore the start
+//
+// Failures abort, so the sanitizers & fuzzers see them as crashes. Without
+// `CHESS_LIBFUZZER` a `main` is added that runs the files given as
+// arguments, stdin (for AFL), or `--random N` generated inputs.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "move.h"
+#include "reference.h"
+
+namespace {
+
+const std::string *current_input = nullptr;  // set by the standalone driver, saved on failure
+
+[[noreturn]] void fail(const char *condition, int line) {
+  std::cerr << "fuzz: " << condition << " failed (line " << line << ")\n";
+  if (current_input) {
+    std::ofstream("crash-input", std::ios::binary) << *current_input;
+    std::cerr << "input written to crash-input\n";
+  }
+  std::abort();
+}
+
+#define FUZZ_ASSERT(condition)                    \
+  do {                                            \
+    if (!(condition)) fail(#condition, __LINE__); \
+  } while (false)
+
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+};
+
+void fuzz_move(const std::string &input) {
+  MoveFactory movemaker;
+  if (!movemaker.valid(input)) return;
+
+  FUZZ_ASSERT(movemaker.parse_move(input)->to_string() == input);
+}
+
+void fuzz_position(const std::string &input) {
+  const std::string pieces = " pnbrqkPNBRQK";
+  bool well_formed = input.size() == 64 && std::all_of(input.begin(), input.end(), [&](char c) {
+                       return pieces.find(c) != std::string::npos;
+                     });
+
+  std::unique_ptr<Game> game;
+  try {
+    game = std::make_unique<Game>(input);
+  } catch (const std::invalid_argument &) {
+    FUZZ_ASSERT(!well_formed);
+    return;
+  }
+  FUZZ_ASSERT(well_formed);
+  FUZZ_ASSERT(game->position() == input);
+
+  // the rules (& `kingpos`) assume at most one king per player:
+  if (std::count(input.begin(), input.end(), 'K') > 1 || std::count(input.begin(), input.end(), 'k') > 1) return;
+
+  for (Player p : {Player::White, Player::Black}) {
+    if (game->to_move() != p) game->swap();
+
+    std::vector<std::string> moves;
+    for (const auto &move : game->legal_moves()) moves.push_back(move->to_string());
+    std::sort(moves.begin(), moves.end());
+
+    FUZZ_ASSERT(moves == reference_moves(input, p));
+    FUZZ_ASSERT(game->in_check(p) == reference_in_check(input, p));
+  }
+}
+
+void fuzz_sequence(const std::string &input) {
+  if (input.empty()) return;
+
+  Game game;
+  uint64_t start = game.hash();
+  size_t next = 0;
+
+  // Beirut variant with bomb carriers picked by the first bytes:
+  if (input[next++] & 1) {
+    game.enable_beirut_mode();
+    for (Player p : {Player::White, Player::Black}) {
+      if (next == input.size()) break;
+      uint8_t pick = input[next++];
+      game.give_bomb(p, Field((p == Player::White ? 6 : 0) + pick / 8 % 2, pick % 8));
+    }
+  }
+
+  for (int steps = 0; next < input.size() && steps < 200; ++steps) {
+    uint8_t byte = input[next++];
+
+    if (byte % 16 == 15) {
+      game.jump_to(game.ply() - 1);
+    } else if (byte % 16 == 14 && game.beirut_mode()) {
+      if (game.boom(game.to_move())) game.swap();
+    } else {
+      auto moves = game.legal_moves();
+      if (moves.empty()) break;
+
+      auto move = moves[byte % moves.size()];
+      FUZZ_ASSERT(game.try_move(move));
+      game.make_move(move);
+      game.swap();
+    }
+
+    Game rebuilt(game.position());
+    if (rebuilt.to_move() != game.to_move()) rebuilt.swap();
+    FUZZ_ASSERT(rebuilt.hash() == game.hash());
+  }
+
+  game.jump_to(0);
+  FUZZ_ASSERT(game.hash() == start);
+  FUZZ_ASSERT(game.position() == Game().position());
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size == 0) return 0;
+
+  static bool quiet = [] {
+    Game::set_script_mode(true);      // no sleeping explosions
+    std::cout.rdbuf(new NullBuffer);  // never freed, `std::cout` is flushed after static destructors ran
+    return true;
+  }();
+  (void)quiet;
+
+  std::string input(reinterpret_cast<const char *>(data) + 1, size - 1);
+  switch (data[0] % 3) {
+    case 0:
+      fuzz_move(input);
+      break;
+    case 1:
+      fuzz_position(input);
+      break;
+    case 2:
+      fuzz_sequence(input);
+      break;
+  }
+  return 0;
+}
+
+#ifndef CHESS_LIBFUZZER
+
+namespace {
+
+std::string read_all(std::istream &in) { return std::string(std::istreambuf_iterator<char>(in), {}); }
+
+void run(const std::string &input) {
+  current_input = &input;
+  LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+}
+
+// random inputs shaped for each target, so they get past the format checks often enough:
+std::string random_input(std::mt19937_64 &rng) {
+  const std::string alphabet = " pnbrqkPNBRQKabcdefgh12345678x=";
+  std::string input(1, char(rng() % 3));
+
+  switch (input[0]) {
+    case 0:
+      for (size_t i = 0, n = rng() % 9; i < n; ++i) input += alphabet[rng() % alphabet.size()];
+      break;
+    case 1:
+      if (rng() % 2) {
+        input += random_position(rng, Player::White);
+        input[1 + rng() % 64] = alphabet[rng() % 13];  // any piece anywhere, even pawns on the edge rows
+      } else {
+        for (size_t i = 0, n = rng() % 70; i < n; ++i) input += char(rng() % 2 ? alphabet[rng() % 13] : rng());
+      }
+      break;
+    default:
+      for (size_t i = 0, n = rng() % 200; i < n; ++i) input += char(rng());
+  }
+  return input;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc == 3 && std::string(argv[1]) == "--random") {
+    std::mt19937_64 rng(std::random_device{}());
+    uint64_t runs = std::stoull(argv[2]);
+    for (uint64_t i = 0; i < runs; ++i) run(random_input(rng));
+    std::cerr << runs << " random inputs, no failures\n";
+    return EXIT_SUCCESS;
+  }
+
+  if (argc == 1) {
+    run(read_all(std::cin));  // AFL feeds inputs on stdin
+    return EXIT_SUCCESS;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      std::cerr << "Could not open " << argv[i] << '\n';
+      return EXIT_FAILURE;
+    }
+    run(read_all(file));
+  }
+  return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "./basics.h"
+
+/* One bit per square, bit `row * 8 + col` (so a8 is bit 0 & h1 is bit 63,
+   matching the row order of `Board`). */
+typedef uint64_t Bitboard;
+
+inline Bitboard square_bit(Field field) { return Bitboard(1) << (field.row * 8 + field.col); }
+
+Bitboard occupancy(const Board &board);
+Bitboard pieces_of(const Board &board, Player p);
+
+/* All squares attacked by `by`, in one pass over the board: the pieces are
+   collected into one bitboard per kind & every kind is spread over the board
+   with shifts (sliders with a flood fill that stops at `occupied`), so all
+   pieces of a kind are handled at once. Squares of either colour count,
+   i.e. defended pieces are attacked. */
+Bitboard attacked_squares(const Board &board, Player by, Bitboard occupied);
+inline Bitboard attacked_squares(const Board &board, Player by) {
+  return attacked_squares(board, by, occupancy(board));
+}
+
+Bitboard king_attacks(Bitboard kings);  // squares next to the given squares
+Bitboard knight_attacks(Bitboard knights);
+Bitboard rook_attacks(Bitboard rooks, Bitboard occupied);  // along rows & columns, up to the first piece
+Bitboard bishop_attacks(Bitboard bishops, Bitboard occupied);
+
+// squares attacked by `piece` (e.g. 'N' or 'p') standing on `from`
+Bitboard piece_attacks(char piece, Field from, Bitboard occupied);
+
+/* Squares the piece on `from` may move to by its own rules (like
+   `Piece::valid`: pawns push onto empty squares & capture diagonally),
+   before checking whether that leaves its king in check. Never the
+   mover's own pieces; 0 for an empty square. */
+Bitboard piece_moves(const Board &board, Field from);
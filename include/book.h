@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./game.h"
+#include "./mapped_file.h"
+#include "./move.h"
+
+/* Opening book file layout: a 16-byte header (8-byte magic, entry count)
+   followed by `BookEntry` records sorted by hash (ties by descending weight).
+   The file is memory-mapped & binary-searched in place, so opening a book is
+   instant regardless of its size. */
+
+struct BookEntry {
+  uint64_t hash;    // `position_hash` of the position before the move
+  uint16_t move;    // `Move::pack` encoding
+  uint16_t weight;  // how often the move was played (saturating)
+  uint32_t reserved;
+};
+
+static_assert(sizeof(BookEntry) == 16, "book entries are stored as raw 16-byte records");
+
+class OpeningBook {
+  MappedFile file_;
+  const BookEntry *entries_;
+  std::size_t count_;
+
+ public:
+  OpeningBook();
+  bool open(const std::string &path);  // false if missing or not a book
+  bool is_open() const;
+  std::size_t size() const;
+  std::vector<BookEntry> lookup(uint64_t hash) const;  // most played first
+  bool contains(uint64_t hash, uint16_t move) const;
+  std::vector<std::shared_ptr<Move>> moves(const Game &game) const;  // book moves in the game's position
+};
+
+class BookBuilder {
+  std::map<std::pair<uint64_t, uint16_t>, uint32_t> counts_;
+  std::size_t games_;
+
+ public:
+  BookBuilder();
+  // `moves` is one game in input notation, separated by whitespace; stops at
+  // `max_plies` or the first invalid move (returns false in that case):
+  bool add_game(const std::string &moves, int max_plies);
+  std::size_t games() const;
+  std::size_t entries() const;
+  bool write(const std::string &path) const;
+};
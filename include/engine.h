@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./game.h"
+#include "./move.h"
+#include "./timeman.h"
+
+class OpeningBook;
+
+/* Engine settings. A depth of 0 plays random valid moves, otherwise the
+   engine runs a fixed-depth alpha-beta search over material. The search
+   heuristics are all on by default; a spec like "depth=4,no-lmr,no-null"
+   switches single ones off (to compare node counts, see `make bench`).
+   Limits: "movetime=MS" caps the time per move; on a clock (see
+   `Game::set_time_control`) the engine budgets its own time. Then `depth`
+   is the deepest iteration. "nodes=N" stops the search after N positions,
+   which unlike time gives the same move on every machine. */
+struct EngineConfig {
+  int depth = 2;
+  uint64_t nodes = 0;    // "nodes=N", 0: no limit
+  int64_t movetime = 0;  // "movetime=MS", 0: no limit
+
+  bool hash_move = true;   // "tt": transposition table, its best move is searched first
+  bool mvv_lva = true;     // "mvv": captures first, most valuable victim / least valuable attacker
+  bool killers = true;     // "killers": quiet moves that caused a cutoff at the same ply
+  bool history = true;     // "history": quiet moves by how often they caused cutoffs anywhere
+  bool null_move = true;   // "null": skip a move, prune if the opponent still cannot catch up
+  bool lmr = true;         // "lmr": search late quiet moves shallower first
+  bool quiescence = true;  // "qs": resolve captures at the horizon instead of stopping mid-exchange
+
+  std::string name() const;
+  // "random" or "depth=N", then ",no-<heuristic>" or limits like ",nodes=N":
+  static bool parse(const std::string &spec, EngineConfig &config);
+};
+
+// a move & its score from the view of the player making it (in centipawns, see `Engine::evaluate`)
+struct MoveScore {
+  std::shared_ptr<Move> move;
+  int score;
+};
+
+class Engine {
+  static const int kMaxPly = 64;
+  static const int kAspiration = 50;  // window around the last score when analysing, see `analyze`
+
+  enum class Bound : uint8_t { Exact, Lower, Upper };
+
+  struct TTEntry {
+    uint64_t hash = 0;
+    int score = 0;
+    int8_t depth = -1;
+    Bound bound = Bound::Exact;
+    uint16_t move = 0;  // packed best move, 0 if none
+  };
+
+  EngineConfig config_;
+  std::mt19937 rng_;
+  std::shared_ptr<const OpeningBook> book_;
+  uint64_t nodes_;
+  std::vector<TTEntry> table_;
+  std::array<std::array<uint16_t, 2>, kMaxPly> killers_;
+  std::array<std::array<int, 64>, 64> history_;
+  std::atomic<bool> stop_;           // ends the background search, see `ponder`
+  const std::atomic<bool> *cancel_;  // the caller's, see `best_move`
+  TimeManager timer_;                // budget of the current `best_move`
+
+  // pondering, see `ponder`:
+  std::thread ponder_thread_;
+  std::atomic<bool> ponder_done_;
+  uint64_t ponder_hash_;  // position searched in the background
+  std::shared_ptr<Move> ponder_result_;
+  uint64_t ponder_hits_;
+
+  bool stopped() const;
+  TimeManager time_budget(const Game &game) const;
+  std::shared_ptr<Move> search_root(Game &game);
+  void stop_pondering();
+  int search(Game &game, int depth, int alpha, int beta, int ply, bool allow_null);
+  int quiesce(Game &game, int alpha, int beta, int ply);
+  void order(std::vector<std::shared_ptr<Move>> &moves, const Game &game, uint16_t hash_move, int ply) const;
+  void remember_cutoff(const Move &move, int depth, int ply);
+
+ public:
+  static const int kMateScore = 100000;
+
+  explicit Engine(EngineConfig config, uint32_t seed = 0);
+  ~Engine();  // stops pondering
+  Engine(const Engine &) = delete;
+  Engine &operator=(const Engine &) = delete;
+  void set_book(std::shared_ptr<const OpeningBook> book);
+  const EngineConfig &config() const;
+
+  /* nullptr if the player to move has no valid move. Setting `cancel` (from
+     another thread) ends the search early, with the best move found so far. */
+  std::shared_ptr<Move> best_move(Game &game, const std::atomic<bool> *cancel = nullptr);
+  uint64_t nodes() const;  // positions searched by the last `best_move`
+
+  /* Multi-PV analysis: scores every valid move (of the piece on `from`, if
+     given), best first. All moves are searched in one tree, deepening
+     together: the transposition table carries results over between sibling
+     moves, and each move is searched in a narrow window around its score
+     from the depth before. Stops like `best_move`, with the scores of the
+     last complete depth (or the partial first one). */
+  std::vector<MoveScore> analyze(Game &game, Field from = Field(), const std::atomic<bool> *cancel = nullptr);
+
+  /* Pondering: during the opponent's turn the engine searches, on a
+     background thread, the position after the reply it expects (the best
+     move its transposition table has for the opponent). If that reply is
+     played, `best_move` waits for the background search & returns its
+     result; otherwise the search is stopped & `best_move` starts over, with
+     the transposition table still warm. Needs the table ("tt"). */
+  bool ponder(const Game &game);  // `game` has the opponent to move; false if no reply is expected
+  std::shared_ptr<Move> expected_reply(Game &game) const;  // nullptr if the table has none
+  uint64_t ponder_hits() const;  // `best_move` calls answered by pondering
+
+  static int evaluate(const Game &game);  // material balance from the view of the player to move
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "./move.h"
+
+/* Everything the game loop reacts to: lines typed by the player (read on a
+   background thread, see `read_input`) & moves found by an engine. */
+struct Event {
+  enum class Kind { Line, EndOfInput, EngineMove };
+
+  Kind kind;
+  std::string line;            // `Line`
+  std::shared_ptr<Move> move;  // `EngineMove`, nullptr if the engine had no move
+  uint64_t position = 0;       // `EngineMove`: hash of the position searched
+  uint64_t search = 0;         // `EngineMove`: which search found it (see `play`), 0 for scripted moves
+};
+
+class EventQueue {
+  std::deque<Event> events_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+
+ public:
+  void push(Event event);
+  Event wait();  // blocks until there is an event
+  // next line of input, other events stay queued (false at the end of input):
+  bool wait_line(std::string &line);
+};
+
+// starts a detached thread that pushes every line of `std::cin` into `queue`
+void read_input(std::shared_ptr<EventQueue> queue);
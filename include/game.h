@@ -1,51 +1,172 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
-#include <stack>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "./attacks.h"
 #include "./basics.h"
 #include "./move.h"
 #include "./pieces.h"
+#include "./stats.h"
+
+class OpeningBook;  // forward declare, only used to highlight book moves
+class Tablebases;   // forward declare, consulted by `checkmate`
+
+/* Squares changed by one move & their previous contents, so `undo` only
+   restores those instead of keeping a copy of the whole board per move. A
+   move changes two squares, kept in place; a detonation clears up to nine,
+   kept in `blast`, which is only allocated when a bomb goes off. */
+struct UndoRecord {
+  typedef std::pair<Field, std::shared_ptr<Piece>> Square;
+
+  std::array<Square, 2> squares;
+  int count = 0;
+  std::unique_ptr<std::vector<Square>> blast;
+
+  void save(const Board &board, Field field);  // into `blast` once there is one
+};
+
+/* History is a persistent linked list: every move adds a node pointing to
+   the previous one & nodes are never modified, so copies of a game (see
+   `fork`) share all of their common history instead of copying it. */
+struct HistoryNode {
+  UndoRecord record;
+  std::shared_ptr<Move> move;
+  Player mover;  // player to move before `move`
+  int ply;       // number of moves up to & including this one
+  std::shared_ptr<const HistoryNode> parent;
+};
+
+/* Time control: `base_ms` on each side's clock, plus `increment_ms` after
+   every move. Written like "5+3" (minutes + increment in seconds). */
+struct TimeControl {
+  int64_t base_ms = 0;  // 0: no clock
+  int64_t increment_ms = 0;
+
+  std::string name() const;
+  static bool parse(const std::string &spec, TimeControl &control);
+};
+
+/* A game waiting for input, in a fraction of the memory: the position it
+   started from & its moves, 2 bytes each (`Move::pack`), instead of a board
+   of piece pointers & an undo record per move. `Game::unpack` replays the
+   moves, so taking them back works as before. Movers alternate. */
+struct PackedGame {
+  std::string start;       // `Game::position` before the first move
+  Bitboard bomb_carriers;  // Beirut variant: at the start, see attacks.h for the square order
+  Player first_mover;
+  Player to_move;
+  bool beirut_mode;
+  std::vector<uint16_t> moves;
+
+  // the clock keeps running while packed:
+  TimeControl time_control;
+  std::array<int64_t, 2> time_left_ms;
+  std::chrono::steady_clock::time_point turn_start;
+
+  uint64_t bytes() const;  // like `Game::memory_usage`
+};
+
+/* Scores of the moves shown by `print_moves`, by destination square
+   (row * 8 + col), in centipawns from the mover's view (see `Engine::analyze`). */
+typedef std::map<int, int> HeatMap;
 
 class Game {
   Board state_;
-  std::stack<Board> history_;
+  std::shared_ptr<const HistoryNode> history_;
   Player current_player_;
   bool beirut_mode_;
+  std::shared_ptr<const Tablebases> tablebases_;
+
+  TimeControl time_control_;
+  std::array<int64_t, 2> time_left_ms_;               // per player, as of `turn_start_`
+  std::chrono::steady_clock::time_point turn_start_;  // when the clock of the player to move started
+
+  void print_status() const;  // whose turn, clocks & commands
+
+  // valid moves of `P` (to move) onto `targets`, only of the piece on `only` if that is valid (see movegen.h):
+  template <Player P>
+  void generate_moves(Field only, Bitboard targets, bool captures_only, std::vector<std::shared_ptr<Move>> &moves);
 
  public:
   Game();
   virtual ~Game() = default;  // needed to make polymorphic (?)
-  explicit Game(const std::string &input);
+  explicit Game(const std::string &input);  // 64 characters (see `position`), std::invalid_argument otherwise
   Board init_board() const;
   void print_board(bool char_view = false) const;
   void show(bool char_view = false) const;
-  Board board() const;
+  static void set_script_mode(bool on);  // scripted input: no screen clearing & no animations
+  const Board &board() const;
+  std::string position() const;  // 64-character board string, as taken by the constructor
   Player to_move() const;  // returns current player
+  uint64_t hash() const;   // Zobrist hash of board & player to move
   void swap();
   void make_move(std::shared_ptr<Move> move);
   void undo();
+
+  // Branching analysis (forks share history & pieces with the original):
+  int ply() const;  // moves made so far
+  std::vector<std::shared_ptr<Move>> moves_played() const;  // oldest first
+  void jump_to(int ply);     // take moves back down to `ply`, restores the player to move
+  Game fork(int ply) const;  // cheap copy taken back to `ply`
   bool substantively_valid(std::shared_ptr<Move> move, bool threat_check) const;
 
+  // Memory (see `PackedGame` for idle games):
+  MemoryUsage memory_usage() const;
+  PackedGame pack() const;  // without the tablebases, set them again after `unpack`
+  static Game unpack(const PackedGame &packed);
+
+  // Endgame tablebases (exact results for positions with few pieces):
+  void set_tablebases(std::shared_ptr<const Tablebases> tablebases);
+  const std::shared_ptr<const Tablebases> &tablebases() const;
+
+  /* Clock: only the game loop runs it (`punch_clock` after every move), so
+     searches & analysis on copies of the game don't use up time. Undoing a
+     move doesn't give the time back. */
+  void set_time_control(TimeControl control);  // resets both clocks & starts the one of the player to move
+  const TimeControl &time_control() const;
+  bool has_clock() const;
+  int64_t time_left(Player p) const;  // ms, the clock of the player to move is running
+  void punch_clock();                 // after a move & `swap`: charges the mover, adds the increment
+  bool flagged(Player p) const;       // out of time
+
   Field kingpos(Player p) const;
   bool in_check(Player p) const;
+  Bitboard attacks(Player by) const;      // squares attacked by `by`, see attacks.h
+  Bitboard king_escapes(Player p) const;  // squares the king of `p` can move to without being in check
   /* `checkmate` and `try_move` are technically const,
   they only make temporary modifications which they revert
   after being called, but we cannot mark them const since
   they need to call non-const members like `make_move`. */
   bool checkmate(Player p);
   bool try_move(std::shared_ptr<Move> move);
-  void print_moves(const std::string &input,
-                   const bool char_view = false);  // same here
+  std::vector<std::shared_ptr<Move>> legal_moves();  // all valid moves of the player to move
+  std::vector<std::shared_ptr<Move>> legal_moves(Field from);  // valid moves of the piece on `from`
+  std::vector<std::shared_ptr<Move>> captures();  // valid captures, without promotions & detonations (quiescence)
+  Bitboard targets(Field from);  // destination squares of those moves (promotions not distinguished)
+  uint64_t perft(int depth);     // number of move sequences `depth` plies deep, to test & time move generation
+  // valid moves of the player to move that check the opponent or blow up their king (see solver.h):
+  std::vector<std::shared_ptr<Move>> checking_moves();
+  // same here; with `heat`, destinations are colored from best (green) to worst (red):
+  void print_moves(const std::string &input, const bool char_view = false,
+                   std::shared_ptr<const OpeningBook> book = nullptr, const HeatMap &heat = HeatMap());
 
   // Beirut-variant specific:
   bool beirut_mode() const;
   void enable_beirut_mode();
-  void get_bomber(Player p, bool char_view = false) const;
+  // reads from `std::cin` unless given another source of lines (false at the end of input):
+  void get_bomber(Player p, bool char_view = false, std::function<bool(std::string &)> read_line = nullptr);
   // ^ view mode necessary because we show the board for picking a bomber
+  bool give_bomb(Player p, Field location);  // false if not a bomb carrier candidate of `p`
+  bool place_bomb(Field location);  // set-up positions (puzzles): any piece but a king, false otherwise
+  std::shared_ptr<Move> bomb_move(Player p) const;  // detonation move, nullptr without carrier
   bool boom(Player p);
   void explosion_effect(int r, int c, bool char_view = false) const;
 };
\ No newline at end of file
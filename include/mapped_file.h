@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* Read-only memory mapping of a whole file. Opening costs one `mmap` call
+   regardless of file size, pages are only read from disk when touched. */
+
+class MappedFile {
+  const char *data_;
+  std::size_t size_;
+
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &path);  // false if the file cannot be mapped
+  void close();
+  bool is_open() const;
+  const char *data() const;
+  std::size_t size() const;
+};
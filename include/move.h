@@ -1,7 +1,7 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
-#include <regex>
 #include <string>
 
 #include "./basics.h"
@@ -12,26 +12,35 @@ class Move {
   Field from_, to_;
   bool promotion_;
   char promote_to_;
+  bool detonation_;  // Beirut variant: the piece on `from_` blows up its bomb
 
  public:
   explicit Move(const std::string &input);
   // alternate constructor to generate hypothetical moves:
   Move(char piece_char, Field from, Field to, bool captures);
+  Move(char piece_char, Field from, Field to, bool captures, char promote_to);
+  // detonation of the bomb carried by the piece at `carrier`:
+  Move(char piece_char, Field carrier);
 
   char piece_char() const;
   bool has_capture() const;
   bool is_promotion() const;
   char promote_to() const;
+  bool is_detonation() const;
   Field from() const;
   Field to() const;
   bool unobstructed(const Board &board) const;
+  std::string to_string() const;  // input notation, e.g. "Nf3xd4"
+  uint16_t pack() const;  // compact encoding for on-disk tables, see `MoveFactory::unpack`
 };
 
+/* Checks the format with a lookup table instead of a `std::regex`, which is
+   costly to build (and used to be built at every start of the game). */
 class MoveFactory {
-  std::regex move_format_;
-
  public:
-  MoveFactory();
-  bool valid(const std::string &input) const;
+  bool valid(const std::string &input) const;  // <piece><from>[x]<to>[=<piece>], e.g. "Nf3xd4", "Pd7d8=Q"
   std::shared_ptr<Move> parse_move(const std::string &input) const;
+  // rebuild a packed move; piece & capture flag are read from the board:
+  std::shared_ptr<Move> unpack(uint16_t packed, const Board &board) const;
+  std::shared_ptr<Move> unpack(uint16_t packed, char piece, bool captures) const;  // ... or given
 };
\ No newline at end of file
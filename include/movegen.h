@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+
+#include "./attacks.h"
+#include "./basics.h"
+#include "./move.h"
+#include "./pieces.h"
+
+enum class PieceKind { Pawn, Knight, Bishop, Rook, Queen, King };
+
+/* Move generation instantiated per side & piece kind: which way pawns go,
+   where they start & which kind of piece moves are all compile-time
+   constants, so the generator's inner loop has no branches on them and no
+   virtual `Piece::valid` calls. Boards are bitboards (see attacks.h). */
+
+template <Player P>
+constexpr Bitboard kPawnStartRow = P == Player::White ? 0x00ff000000000000ULL : 0x000000000000ff00ULL;
+
+template <Player P>
+constexpr Bitboard kPromotionRow = P == Player::White ? 0x00000000000000ffULL : 0xff00000000000000ULL;
+
+// one row forward, towards row 0 for white:
+template <Player P>
+constexpr Bitboard forward(Bitboard squares) {
+  return P == Player::White ? squares >> 8 : squares << 8;
+}
+
+template <Player P>
+constexpr Bitboard pawn_attacks(Bitboard pawns) {
+  const Bitboard kNotFileA = 0xfefefefefefefefeULL;
+  const Bitboard kNotFileH = 0x7f7f7f7f7f7f7f7fULL;
+  return P == Player::White ? ((pawns >> 7) & kNotFileA) | ((pawns >> 9) & kNotFileH)
+                            : ((pawns << 9) & kNotFileA) | ((pawns << 7) & kNotFileH);
+}
+
+// squares the `K` of `P` on `piece` may move to by its own rules (see `piece_moves`), `own`: pieces of `P`
+template <Player P, PieceKind K>
+Bitboard destinations(Bitboard piece, Bitboard occupied, Bitboard own) {
+  if constexpr (K == PieceKind::Pawn) {
+    Bitboard push = forward<P>(piece) & ~occupied;
+    Bitboard double_push = forward<P>(push & forward<P>(kPawnStartRow<P>)) & ~occupied;
+    return push | double_push | (pawn_attacks<P>(piece) & occupied & ~own);
+  } else if constexpr (K == PieceKind::Knight) {
+    return knight_attacks(piece) & ~own;
+  } else if constexpr (K == PieceKind::Bishop) {
+    return bishop_attacks(piece, occupied) & ~own;
+  } else if constexpr (K == PieceKind::Rook) {
+    return rook_attacks(piece, occupied) & ~own;
+  } else if constexpr (K == PieceKind::Queen) {
+    return (rook_attacks(piece, occupied) | bishop_attacks(piece, occupied)) & ~own;
+  } else {
+    return king_attacks(piece) & ~own;
+  }
+}
+
+// the kind of a piece character, e.g. 'n' -> Knight
+inline PieceKind piece_kind(char piece) {
+  switch (std::tolower(piece)) {
+    case 'p': return PieceKind::Pawn;
+    case 'n': return PieceKind::Knight;
+    case 'b': return PieceKind::Bishop;
+    case 'r': return PieceKind::Rook;
+    case 'q': return PieceKind::Queen;
+  }
+  return PieceKind::King;
+}
+
+// one switch per piece (not per square) into the instantiation for its kind
+template <Player P>
+Bitboard destinations(PieceKind kind, Bitboard piece, Bitboard occupied, Bitboard own) {
+  switch (kind) {
+    case PieceKind::Pawn: return destinations<P, PieceKind::Pawn>(piece, occupied, own);
+    case PieceKind::Knight: return destinations<P, PieceKind::Knight>(piece, occupied, own);
+    case PieceKind::Bishop: return destinations<P, PieceKind::Bishop>(piece, occupied, own);
+    case PieceKind::Rook: return destinations<P, PieceKind::Rook>(piece, occupied, own);
+    case PieceKind::Queen: return destinations<P, PieceKind::Queen>(piece, occupied, own);
+    case PieceKind::King: break;
+  }
+  return destinations<P, PieceKind::King>(piece, occupied, own);
+}
+
+/* The same rules for one move at a time (`Game::substantively_valid`): whether
+   the `K` of `P` may go from `move.from()` to `move.to()` on `board`. Whose
+   pieces stand on either square is up to the caller. */
+template <Player P, PieceKind K>
+bool reaches(const Move &move, const Board &board) {
+  Field from = move.from();
+  Field to = move.to();
+  int dx = to.col - from.col;
+  int dy = to.row - from.row;
+
+  if constexpr (K == PieceKind::Pawn) {
+    constexpr int kDirection = Pawn<P>::kDirection;
+    if (dx == 0 && dy == kDirection) return !board[to.row][to.col];
+    if (dx == 0 && dy == 2 * kDirection)
+      return from.row == Pawn<P>::kStartRow && !board[to.row][to.col] && move.unobstructed(board);
+    return std::abs(dx) == 1 && dy == kDirection && move.has_capture() && board[to.row][to.col];
+  } else if constexpr (K == PieceKind::Knight) {
+    return (std::abs(dx) == 2 && std::abs(dy) == 1) || (std::abs(dx) == 1 && std::abs(dy) == 2);
+  } else if constexpr (K == PieceKind::Bishop) {
+    return std::abs(dx) == std::abs(dy) && move.unobstructed(board);
+  } else if constexpr (K == PieceKind::Rook) {
+    return (dx == 0 || dy == 0) && move.unobstructed(board);
+  } else if constexpr (K == PieceKind::Queen) {
+    return (std::abs(dx) == std::abs(dy) || dx == 0 || dy == 0) && move.unobstructed(board);
+  } else {
+    return std::abs(dx) <= 1 && std::abs(dy) <= 1;
+  }
+}
+
+template <Player P>
+bool reaches(PieceKind kind, const Move &move, const Board &board) {
+  switch (kind) {
+    case PieceKind::Pawn: return reaches<P, PieceKind::Pawn>(move, board);
+    case PieceKind::Knight: return reaches<P, PieceKind::Knight>(move, board);
+    case PieceKind::Bishop: return reaches<P, PieceKind::Bishop>(move, board);
+    case PieceKind::Rook: return reaches<P, PieceKind::Rook>(move, board);
+    case PieceKind::Queen: return reaches<P, PieceKind::Queen>(move, board);
+    case PieceKind::King: break;
+  }
+  return reaches<P, PieceKind::King>(move, board);
+}
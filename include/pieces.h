@@ -1,9 +1,7 @@
 #pragma once
 
 #include <cmath>
-#include <functional>
 #include <memory>
-#include <unordered_map>
 
 #include "./basics.h"
 #include "./move.h"
@@ -16,56 +14,71 @@ class Piece {
   bool carries_bomb_;  // for beirut variant
 
  public:
-  Piece(Player p, char c);
+  // constexpr, so the shared prototypes of `PieceFactory` need no start-up code
+  constexpr Piece(Player p, char c, uint32_t unicode)
+      : player_(p), rep_(p == Player::White ? c : char(c - 'A' + 'a')), unicode_(unicode), carries_bomb_(false) {}
   char to_char() const;
   std::string unicode() const;
   Player owner() const;
-  virtual bool valid(std::shared_ptr<Move> move, const Board &board) const = 0;
+  virtual bool valid(const Move &move, const Board &board) const = 0;
   // for beirut variant:
   bool carries_bomb() const;
+
+ private:
+  // only for pieces of their own, not the shared prototypes (see `PieceFactory`):
+  friend class PieceFactory;
   void give_bomb();
 };
 
 class Bishop : public Piece {
  public:
-  explicit Bishop(Player p);
-  bool valid(std::shared_ptr<Move> move, const Board &board) const override;
+  constexpr explicit Bishop(Player p) : Piece(p, 'B', 0x265D) {}
+  bool valid(const Move &move, const Board &board) const override;
 };
 
 class King : public Piece {
  public:
-  explicit King(Player p);
-  bool valid(std::shared_ptr<Move> move, const Board &board) const override;
+  constexpr explicit King(Player p) : Piece(p, 'K', 0x265A) {}
+  bool valid(const Move &move, const Board &board) const override;
 };
 
 class Knight : public Piece {
  public:
-  explicit Knight(Player p);
-  bool valid(std::shared_ptr<Move> move, const Board &board) const override;
+  constexpr explicit Knight(Player p) : Piece(p, 'N', 0x265E) {}
+  bool valid(const Move &move, const Board &board) const override;
 };
 
+/* The only piece that moves differently per side, so there is one class per
+   side: direction & starting row are constants instead of being worked out
+   on every call. */
+template <Player P>
 class Pawn : public Piece {
  public:
-  explicit Pawn(Player p);
-  bool valid(std::shared_ptr<Move> move, const Board &board) const override;
+  static constexpr int kDirection = P == Player::White ? -1 : 1;  // rows per step
+  static constexpr int kStartRow = P == Player::White ? 6 : 1;
+
+  constexpr Pawn() : Piece(P, 'P', 0x265F) {}
+  bool valid(const Move &move, const Board &board) const override;
 };
 
 class Queen : public Piece {
  public:
-  explicit Queen(Player p);
-  bool valid(std::shared_ptr<Move> move, const Board &board) const override;
+  constexpr explicit Queen(Player p) : Piece(p, 'Q', 0x265B) {}
+  bool valid(const Move &move, const Board &board) const override;
 };
 
 class Rook : public Piece {
  public:
-  explicit Rook(Player p);
-  bool valid(std::shared_ptr<Move> move, const Board &board) const override;
+  constexpr explicit Rook(Player p) : Piece(p, 'R', 0x265C) {}
+  bool valid(const Move &move, const Board &board) const override;
 };
 
+/* Pieces carry no state of their own apart from a bomb, so all boards share
+   one prototype per piece: `make_piece` hands out pointers to them without
+   allocating or reference counting. Bomb carriers are the exception, each one
+   is a piece of its own (see `Game::give_bomb`). */
 class PieceFactory {
-  std::unordered_map<char, std::function<std::shared_ptr<Piece>(Player)>> pieces_;
-
  public:
-  PieceFactory();
-  std::shared_ptr<Piece> make_piece(char c) const;
-};
\ No newline at end of file
+  static std::shared_ptr<Piece> make_piece(char c);
+  static std::shared_ptr<Piece> make_bomb_carrier(char c);  // a new piece, carrying a bomb
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./book.h"
+#include "./engine.h"
+#include "./events.h"
+#include "./game.h"
+#include "./session_log.h"
+#include "./tablebase.h"
+
+// the computer side, if any:
+struct Opponent {
+  std::shared_ptr<Engine> engine;  // nullptr for two human players
+  Player side = Player::Black;
+  bool ponder = false;
+  bool scripted = false;  // replays: the moves of `side` come in as events, nobody searches
+};
+
+/* Everything set up from the command line. */
+struct PlayOptions {
+  bool beirut = false;
+  bool char_mode = false;  // by default, try to show board with unicode piece chars
+  std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>();
+  std::shared_ptr<Tablebases> tablebases = std::make_shared<Tablebases>();
+  Opponent opponent;
+  std::shared_ptr<Engine> analyst;  // scores for the :m preview, nullptr for none
+  TimeControl time_control;
+  std::shared_ptr<SessionLog> log;  // nullptr for none
+};
+
+// false (& a message on `std::cerr`) for invalid arguments; a log gets the arguments as its `Start` record:
+bool parse_options(const std::vector<std::string> &args, PlayOptions &options);
+
+void show_prompt();
+
+// scores of the moves of the piece in `input` (e.g. "Ng1") for the :m preview, empty without analysis;
+// searches on the calling thread, for up to the analyst's `movetime`
+HeatMap heat_map(Game &game, const std::string &input, std::shared_ptr<Engine> analyst);
+
+// sets up a game & runs it until :q, the end of the game or the end of input (see `read_input`)
+void play(std::shared_ptr<EventQueue> events, PlayOptions options);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./game.h"
+#include "./mapped_file.h"
+
+/* Position index file layout: a 32-byte header (8-byte magic, key count,
+   posting count, reserved), the `IndexKey` records sorted by hash, then the
+   `IndexPosting` records, grouped by key & sorted by game within a key. Like
+   the opening book, the file is memory-mapped & binary-searched in place.
+   Positions are identified by `position_hash` (board & player to move). */
+
+struct IndexKey {
+  uint64_t hash;
+  uint64_t first;        // index of the key's first posting
+  uint32_t games;        // number of postings
+  uint32_t occurrences;  // times the position was reached, over all games (saturating)
+};
+
+struct IndexPosting {
+  uint32_t game;         // game id: 0-based line number in the archive
+  uint16_t first_ply;    // moves played when the position was first reached (saturating)
+  uint16_t occurrences;  // times the position was reached in this game (saturating)
+};
+
+static_assert(sizeof(IndexKey) == 24, "keys are stored as raw 24-byte records");
+static_assert(sizeof(IndexPosting) == 8, "postings are stored as raw 8-byte records");
+
+class PositionIndex {
+  MappedFile file_;
+  const IndexKey *keys_;
+  const IndexPosting *postings_;
+  std::size_t key_count_;
+  std::size_t posting_count_;  // a key's postings are checked against it, the file may be corrupt
+
+  const IndexKey *find_key(uint64_t hash) const;
+
+ public:
+  PositionIndex();
+  bool open(const std::string &path);  // false if missing or not an index
+  bool is_open() const;
+  std::size_t size() const;  // distinct positions
+
+  std::vector<IndexPosting> games(uint64_t hash) const;  // every game that reached the position, by id
+  std::vector<IndexPosting> games(const Game &game) const;
+  uint32_t occurrences(uint64_t hash) const;  // 0 if never reached
+};
+
+/* Builds an index with an external-memory sort-merge, so archives larger
+   than memory can be indexed: (hash, game, ply) records are collected up to
+   `memory_budget` bytes, sorted & spilled to a run file next to the output,
+   and `finish` merges the runs (at most 16 at a time) while writing the index. */
+class PositionIndexBuilder {
+ public:
+  struct Occurrence {
+    uint64_t hash;
+    uint32_t game;
+    uint32_t ply;
+  };
+
+ private:
+  std::string path_;
+  std::size_t run_capacity_;  // records per run
+  std::vector<Occurrence> buffer_;
+  std::vector<std::string> runs_;  // run files not merged yet
+  std::size_t run_count_;
+  uint32_t games_;
+  uint64_t positions_;
+  bool ok_;  // every run was written
+
+  bool spill();
+
+ public:
+  explicit PositionIndexBuilder(const std::string &path, std::size_t memory_budget = 64 << 20);
+  ~PositionIndexBuilder();  // removes leftover run files
+  PositionIndexBuilder(const PositionIndexBuilder &) = delete;
+  PositionIndexBuilder &operator=(const PositionIndexBuilder &) = delete;
+
+  // `moves` is one game in input notation, separated by whitespace; indexes
+  // the start position & the position after every move up to `max_plies` or
+  // the first invalid move (returns false in that case, or if a run could
+  // not be written, see `ok`). The game gets the next id, also for empty or
+  // invalid games, so ids stay line numbers.
+  bool add_game(const std::string &moves, int max_plies = 1000);
+  bool ok() const;  // false once a run could not be written, the index would miss its positions
+  uint32_t games() const;
+  uint64_t positions() const;  // positions seen, counting repeats
+  std::size_t runs() const;    // sorted runs written (all of them, once finished)
+  bool finish();               // merges the runs into the index file at `path`, call once
+};
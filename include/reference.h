@@ -0,0 +1,20 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "./basics.h"
+
+/* A deliberately plain move generator to test `Game` against (bin/difftest,
+   the fuzz harness & DifferentialTest). It works on the 64-character
+   position string with nested loops over squares & rays: no attack maps, no
+   trial moves, no shared code with `Game`, written to be obviously right
+   rather than fast. Same rules as `Game`: no castling & no en passant, a
+   pawn on the last row may promote or stay a pawn. Bombs are not modeled,
+   and positions need at most one king per player. */
+std::vector<std::string> reference_moves(const std::string &position, Player to_move);  // sorted, `Move::to_string`
+bool reference_in_check(const std::string &position, Player p);  // false without a king, like `Game::in_check`
+
+// a random legal position: both kings, not adjacent, the player not to move not in check, no pawns on the edge rows
+std::string random_position(std::mt19937_64 &rng, Player to_move);
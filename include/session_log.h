@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./move.h"
+
+enum class LogKind : uint8_t { Start, Line, Bomber, EngineMove };
+
+/* One entry of a session log, in the order the game loop consumed it. */
+struct LogRecord {
+  uint64_t time_us = 0;     // wall clock, µs since the epoch
+  uint32_t latency_us = 0;  // `Line`: handling the input, `EngineMove`: search & making the move
+  LogKind kind = LogKind::Line;
+  uint64_t position = 0;  // hash of the position after the record was handled
+  // `Start`: the arguments, '\0'-separated; `Line` & `Bomber`: the input; `EngineMove`: see `encode_move`
+  std::string data;
+};
+
+/* Append-only binary log of everything `play` reacts to: the lines typed
+   (bombers picked via `Game::get_bomber` separately, after their line) &
+   the engine's moves, which are not reproducible from a seed. Together
+   with the `Start` record that is enough to replay a session exactly, see
+   tools/replay.cpp.
+
+   File layout: "CHLOG001", then per record time (u64), latency (u32),
+   kind (u8), position (u64), data size (u16) & data, in host byte order.
+   Records are serialized into a buffer & written by a background thread
+   (every 4KB or 100ms), so logging never waits for the disk. */
+class SessionLog {
+  std::string path_;  // "" keeps the records in memory
+  std::ofstream file_;
+  std::vector<LogRecord> records_;  // in-memory logs
+  std::string buffer_;              // serialized, not yet written
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable flush_;
+  std::thread writer_;
+
+  void write_loop();
+
+ public:
+  static const size_t kFlushBytes = 4096;
+  static const int kFlushMs = 100;
+
+  explicit SessionLog(const std::string &path);  // appends to `path`, "" for in-memory
+  ~SessionLog();                                 // writes what is left
+  SessionLog(const SessionLog &) = delete;
+  SessionLog &operator=(const SessionLog &) = delete;
+
+  bool ok() const;  // the file could be opened
+  void record(LogKind kind, const std::string &data, uint64_t position, uint32_t latency_us = 0);
+  std::vector<LogRecord> records();  // in-memory logs only
+
+  // all records of a log file; a torn last record (crash while writing) is dropped, false if not a log:
+  static bool read(const std::string &path, std::vector<LogRecord> &records);
+
+  // `EngineMove` data: hash of the position searched (8), piece (1), capture flag (1) & packed move (2)
+  static std::string encode_move(const Move &move, uint64_t searched);
+  static std::shared_ptr<Move> decode_move(const std::string &data, uint64_t &searched);  // nullptr if malformed
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./game.h"
+
+/* Outcome of a mate search, moves in input notation (e.g. "Qd1h5"). */
+struct MateResult {
+  bool mate = false;               // the player to move mates in at most `max_moves`
+  int moves = 0;                   // shortest mate (moves of the mating side), 0 without
+  std::vector<std::string> keys;   // first moves that mate in `moves` (all of them with `all_keys`)
+  std::vector<std::string> line;   // key & best defence, alternating, up to the mate
+  uint64_t nodes = 0;              // positions searched
+};
+
+/* Proves or refutes "mate in N" for the player to move: depth-first, one
+   more move at a time until `max_moves`, so the shortest mate comes first.
+   The mating side's last move has to give check (or blow up the king in
+   the Beirut variant), so only those are generated there; the defence
+   tries every legal move, detonations included. Root moves are shared out
+   between `threads` (0: one per core), each with its own copy of the game
+   & table of refuted positions. Without `all_keys` the search stops at the
+   first key. Stalemate & a king lost by the mating side are no mate. */
+MateResult solve_mate(const Game &game, int max_moves, int threads = 0, bool all_keys = false);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/* Lightweight counters & timers around the hot paths. Everything is compiled
+   out unless the build defines `CHESS_STATS` (`make STATS=1`), so the
+   instrumentation macros below cost nothing in a normal build. Counters are
+   kept per thread; `Stats::report` & `Stats::dump` show the calling thread's
+   numbers. Timings are inclusive (e.g. `try_move` includes `make_move`). */
+
+enum class Counter {
+  TryMove,
+  InCheck,
+  SubstantivelyValid,
+  MakeMove,
+  Undo,
+  Checkmate,
+  MoveFormat,
+  ParseMove,
+  Count  // number of counters, keep last
+};
+
+struct CounterStats {
+  uint64_t calls = 0;
+  uint64_t nanos = 0;
+};
+
+/* Bytes held by one game (see `Game::memory_usage`), inline & on the heap.
+   Measuring is cheap, so it works in every build. */
+struct MemoryUsage {
+  uint64_t board = 0;    // `state_`: the nested vectors of piece pointers
+  uint64_t history = 0;  // undo records & moves, shared history counted in full
+  uint64_t pieces = 0;   // heap pieces (bomb carriers); the shared prototypes cost nothing per game
+
+  uint64_t total() const;
+};
+
+class Stats {
+  CounterStats counters_[static_cast<int>(Counter::Count)];
+  MemoryUsage memory_;  // last reported with `set_memory`
+
+ public:
+  static Stats &local();  // this thread's counters
+  static bool enabled();  // whether the build was instrumented
+  static const char *name(Counter c);
+
+  CounterStats &operator[](Counter c);
+  const CounterStats &operator[](Counter c) const;
+  void reset();
+  void set_memory(const MemoryUsage &memory);  // shown alongside the counters
+
+  void report(std::ostream &os) const;  // human-readable table (`:s` command)
+  void dump(std::ostream &os) const;    // machine-readable (JSON) dump
+};
+
+class ScopedTimer {
+  CounterStats &target_;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  explicit ScopedTimer(Counter c);
+  ~ScopedTimer();
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+#define STATS_CONCAT_INNER(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_INNER(a, b)
+
+#ifdef CHESS_STATS
+#define STATS_SCOPE(counter) ScopedTimer STATS_CONCAT(stats_timer_, __LINE__)(counter)
+#else
+#define STATS_SCOPE(counter) \
+  do {                       \
+  } while (false)
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./basics.h"
+
+/* Endgame tablebases for up to four pieces (kings included). A table covers
+   one material signature such as "KQvK" (white's pieces, 'v', black's
+   pieces) with either side to move, and stores win/draw/loss plus the
+   distance to mate in plies for every placement of the pieces. Positions use
+   the same 64-character board string as `Game(const std::string &)`. */
+
+enum class Wdl { Loss, Draw, Win };
+
+struct TbResult {
+  Wdl wdl;
+  int dtm;  // plies until mate for decisive results (0 = side to move is mated), 0 for draws
+};
+
+class Tablebase {
+  std::string signature_;
+  std::vector<char> pieces_;    // piece characters in index order, white first
+  unsigned bits_;               // bits per packed entry
+  std::vector<uint64_t> data_;  // bit-packed entries, see `encode`
+
+ public:
+  static const int kMaxPieces = 4;
+
+  Tablebase();
+  explicit Tablebase(const std::string &signature);  // empty table, filled in by the generator
+
+  static std::string signature_of(const std::string &position);  // e.g. "KQvK"
+  static std::string flipped(const std::string &signature);      // colors swapped, "KvKQ"
+  static bool valid_signature(const std::string &signature);
+
+  const std::string &signature() const;
+  const std::vector<char> &pieces() const;
+  uint64_t entries() const;  // number of indices (placements x side to move)
+
+  // index of a position with exactly this table's material (pieces in any order):
+  uint64_t index(const std::string &position, bool white_to_move) const;
+  TbResult result(uint64_t index) const;
+
+  void store(const std::vector<uint16_t> &codes);  // packs generator output, see `encode`
+  static uint16_t encode(Wdl wdl, int dtm);
+
+  bool load(const std::string &path);
+  bool save(const std::string &path) const;
+};
+
+class Tablebases {
+  std::map<std::string, std::shared_ptr<const Tablebase>> tables_;
+
+ public:
+  void add(std::shared_ptr<const Tablebase> table);
+  int load_directory(const std::string &directory);  // loads all `*.tb` files, returns how many
+  std::shared_ptr<const Tablebase> find(const std::string &signature) const;
+  std::vector<std::shared_ptr<const Tablebase>> tables() const;
+  std::size_t size() const;
+
+  // false if the material is not covered (too many pieces or table missing):
+  bool probe(const std::string &position, Player to_move, TbResult &result) const;
+  bool probe(const Board &board, Player to_move, TbResult &result) const;
+};
+
+class TablebaseGenerator {
+  Tablebases &registry_;
+  unsigned threads_;
+
+ public:
+  TablebaseGenerator(Tablebases &registry, unsigned threads);
+  // generates the table & every missing table reachable by captures or
+  // promotions, all of which are added to the registry:
+  std::shared_ptr<const Tablebase> generate(const std::string &signature);
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/* Splits the time on the clock into a budget for one move. Iterative
+   deepening starts no new iteration past the soft limit (later when the
+   position is unstable: the best move just changed or the score dropped),
+   and the search is stopped outright at the hard limit. The hard limit
+   keeps `kLatencyMs` in reserve for unwinding the search & reporting the
+   move, so a move never takes longer than the clock (or `movetime`) allows. */
+class TimeManager {
+  std::chrono::steady_clock::time_point start_;
+  bool limited_;  // a clock or `movetime`, the limits below are only meaningful with one
+  int64_t soft_ms_;
+  int64_t hard_ms_;
+
+ public:
+  static const int64_t kMovesToGo = 30;  // the rest of the game is assumed to take this many moves
+  static const int64_t kLatencyMs = 10;  // reserve for stopping & reporting, see above
+
+  TimeManager();  // no limit
+
+  // all in ms, 0 for none; the budget is the smaller one when both a clock & `movetime` are given:
+  void start(int64_t time_left, int64_t increment, int64_t movetime);
+  bool limited() const;
+  int64_t elapsed() const;  // ms since `start`
+  int64_t soft_limit() const;
+  int64_t hard_limit() const;
+
+  bool out_of_time() const;                   // past the hard limit
+  bool next_iteration(bool unstable) const;  // whether another iteration is likely to finish in time
+};
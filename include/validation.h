@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./basics.h"
+
+/* One question about a position. `query` is either a move in the usual input
+   notation ("Pe2e4", "Nb1xc3") asking whether it is valid, or a piece & its
+   field ("Pe2", as for :m) asking for all valid moves of that piece. */
+struct ValidationRequest {
+  std::string position;  // 64 characters, as taken by `Game(const std::string &)`
+  Player to_move = Player::White;
+  std::string query;
+};
+
+struct ValidationResult {
+  bool well_formed = false;  // position & query could be read
+  bool valid = false;        // move queries: the move is valid; piece queries: the piece has moves
+  std::vector<std::string> moves;  // piece queries: the piece's valid moves
+};
+
+/* Answers batches of validation requests on a pool of worker threads.
+   Requests of a batch that share a position are answered by one task, which
+   decodes the position once & runs all of its queries through the same
+   `Game` (`Game::try_move`, i.e. `substantively_valid` plus the check test). */
+class ValidationService {
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_;
+
+  void work();
+  void enqueue(std::function<void()> task);
+
+ public:
+  explicit ValidationService(unsigned threads = std::thread::hardware_concurrency());
+  ~ValidationService();  // finishes queued work before returning
+  ValidationService(const ValidationService &) = delete;
+  ValidationService &operator=(const ValidationService &) = delete;
+
+  // results are in the order of the requests:
+  std::future<std::vector<ValidationResult>> submit(std::vector<ValidationRequest> batch);
+  void submit(std::vector<ValidationRequest> batch, std::function<void(std::vector<ValidationResult>)> done);
+  size_t threads() const;
+
+  static ValidationResult validate(const ValidationRequest &request);  // single request on the calling thread
+};
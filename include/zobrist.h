@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+#include "./basics.h"
+
+/* Zobrist hashing: every (piece, square) combination & the side to move gets
+   a fixed random key, a position's hash is the XOR of the keys present. The
+   keys are generated at compile time, so hashes are stable across runs and
+   can be stored on disk (opening book, position index). */
+
+uint64_t zobrist_key(char piece, int square);  // square = row * 8 + col
+uint64_t zobrist_black_to_move();
+uint64_t position_hash(const Board &board, Player to_move);
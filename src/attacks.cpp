@@ -0,0 +1,143 @@
+//===----------------------------------------------------------------------===//
+//
+// Whole-board attack sets on 64-bit boards. Instead of asking every piece
+// whether it can capture on one particular square (as `substantively_valid`
+// does), each kind of piece is turned into a bitboard and shifted in all of
+// its directions at once; sliding pieces use a Kogge-Stone flood fill, which
+// needs three shifts per direction no matter how many sliders there are.
+//
+//===----------------------------------------------------------------------===//
+
+#include "attacks.h"
+
+#include <cctype>
+
+#include "movegen.h"
+#include "pieces.h"
+
+namespace {
+
+const Bitboard kNotFileA = 0xfefefefefefefefeULL;
+const Bitboard kNotFileH = 0x7f7f7f7f7f7f7f7fULL;
+const Bitboard kNotFilesAB = 0xfcfcfcfcfcfcfcfcULL;
+const Bitboard kNotFilesGH = 0x3f3f3f3f3f3f3f3fULL;
+
+// a positive shift moves towards h1 (down the board / right), a negative one towards a8:
+Bitboard shift(Bitboard b, int by) { return by > 0 ? b << by : b >> -by; }
+
+/* Directions as bit offsets & the mask of squares a step in that direction
+   may land on (stepping right must not wrap from the h-file onto the a-file). */
+struct Direction {
+  int offset;
+  Bitboard mask;
+};
+
+const Direction kOrthogonal[] = {{1, kNotFileA}, {-1, kNotFileH}, {8, ~Bitboard(0)}, {-8, ~Bitboard(0)}};
+const Direction kDiagonal[] = {{9, kNotFileA}, {7, kNotFileH}, {-7, kNotFileA}, {-9, kNotFileH}};
+
+// every square reachable from `sliders` along `dir`, including the first blocker
+Bitboard slide(Bitboard sliders, Direction dir, Bitboard occupied) {
+  Bitboard empty = ~occupied & dir.mask;  // squares a ray may pass through
+  int offset = dir.offset;
+
+  sliders |= empty & shift(sliders, offset);
+  empty &= shift(empty, offset);
+  sliders |= empty & shift(sliders, 2 * offset);
+  empty &= shift(empty, 2 * offset);
+  sliders |= empty & shift(sliders, 4 * offset);
+
+  return shift(sliders, offset) & dir.mask;
+}
+
+}  // namespace
+
+Bitboard knight_attacks(Bitboard knights) {
+  return ((knights >> 17) & kNotFileH) | ((knights >> 15) & kNotFileA) | ((knights >> 10) & kNotFilesGH) |
+         ((knights >> 6) & kNotFilesAB) | ((knights << 6) & kNotFilesGH) | ((knights << 10) & kNotFilesAB) |
+         ((knights << 15) & kNotFileH) | ((knights << 17) & kNotFileA);
+}
+
+Bitboard rook_attacks(Bitboard rooks, Bitboard occupied) {
+  Bitboard attacks = 0;
+  for (const auto &dir : kOrthogonal) attacks |= slide(rooks, dir, occupied);
+  return attacks;
+}
+
+Bitboard bishop_attacks(Bitboard bishops, Bitboard occupied) {
+  Bitboard attacks = 0;
+  for (const auto &dir : kDiagonal) attacks |= slide(bishops, dir, occupied);
+  return attacks;
+}
+
+Bitboard occupancy(const Board &board) {
+  Bitboard occupied = 0;
+  for (int row = 0; row < 8; ++row)
+    for (int col = 0; col < 8; ++col)
+      if (board[row][col]) occupied |= square_bit(Field(row, col));
+  return occupied;
+}
+
+Bitboard pieces_of(const Board &board, Player p) {
+  Bitboard pieces = 0;
+  for (int row = 0; row < 8; ++row)
+    for (int col = 0; col < 8; ++col)
+      if (board[row][col] && board[row][col]->owner() == p) pieces |= square_bit(Field(row, col));
+  return pieces;
+}
+
+Bitboard king_attacks(Bitboard kings) {
+  Bitboard sideways = ((kings << 1) & kNotFileA) | ((kings >> 1) & kNotFileH);
+  Bitboard row = kings | sideways;
+  return sideways | (row << 8) | (row >> 8);
+}
+
+Bitboard attacked_squares(const Board &board, Player by, Bitboard occupied) {
+  Bitboard pawns = 0, knights = 0, kings = 0, orthogonal = 0, diagonal = 0;
+
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      const auto &piece = board[row][col];
+      if (!piece || piece->owner() != by) continue;
+
+      Bitboard bit = square_bit(Field(row, col));
+      switch (std::tolower(piece->to_char())) {
+        case 'p': pawns |= bit; break;
+        case 'n': knights |= bit; break;
+        case 'k': kings |= bit; break;
+        case 'r': orthogonal |= bit; break;
+        case 'b': diagonal |= bit; break;
+        case 'q': orthogonal |= bit; diagonal |= bit; break;
+      }
+    }
+  }
+
+  // white pawns capture towards row 0, black pawns towards row 7:
+  Bitboard attacks = by == Player::White ? pawn_attacks<Player::White>(pawns) : pawn_attacks<Player::Black>(pawns);
+  attacks |= knight_attacks(knights) | king_attacks(kings);
+  return attacks | rook_attacks(orthogonal, occupied) | bishop_attacks(diagonal, occupied);
+}
+
+Bitboard piece_attacks(char piece, Field from, Bitboard occupied) {
+  Bitboard bit = square_bit(from);
+
+  switch (std::tolower(piece)) {
+    case 'p': return std::isupper(piece) ? pawn_attacks<Player::White>(bit) : pawn_attacks<Player::Black>(bit);
+    case 'n': return knight_attacks(bit);
+    case 'k': return king_attacks(bit);
+    case 'r': return rook_attacks(bit, occupied);
+    case 'b': return bishop_attacks(bit, occupied);
+    case 'q': return rook_attacks(bit, occupied) | bishop_attacks(bit, occupied);
+  }
+  return 0;
+}
+
+Bitboard piece_moves(const Board &board, Field from) {
+  const auto &piece = board[from.row][from.col];
+  if (!piece) return 0;
+
+  Bitboard occupied = occupancy(board);
+  Bitboard own = pieces_of(board, piece->owner());
+  PieceKind kind = piece_kind(piece->to_char());
+  return piece->owner() == Player::White ? destinations<Player::White>(kind, square_bit(from), occupied, own)
+                                         : destinations<Player::Black>(kind, square_bit(from), occupied, own);
+}
@@ -0,0 +1,145 @@
+//===----------------------------------------------------------------------===//
+//
+// The opening book maps position hashes to moves seen in a game collection.
+// `BookBuilder` replays games through `Game` (so only valid moves end up in
+// the book) and writes the sorted table, `OpeningBook` maps it read-only.
+//
+//===----------------------------------------------------------------------===//
+
+#include "book.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "zobrist.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'H', 'B', 'O', 'O', 'K', '0', '1'};
+
+struct BookHeader {
+  char magic[8];
+  uint64_t count;
+};
+
+static_assert(sizeof(BookHeader) == sizeof(BookEntry), "header keeps entries aligned");
+
+bool entry_order(const BookEntry &a, const BookEntry &b) {
+  return a.hash != b.hash ? a.hash < b.hash : a.weight > b.weight;
+}
+
+}  // namespace
+
+// Opening book
+
+OpeningBook::OpeningBook() : entries_(nullptr), count_(0) {}
+
+bool OpeningBook::open(const std::string &path) {
+  entries_ = nullptr;
+  count_ = 0;
+
+  if (!file_.open(path)) return false;
+
+  const auto *header = reinterpret_cast<const BookHeader *>(file_.data());
+  // the count is checked against the file before multiplying, a crafted one could overflow:
+  if (file_.size() < sizeof(BookHeader) || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->count > (file_.size() - sizeof(BookHeader)) / sizeof(BookEntry) ||
+      file_.size() != sizeof(BookHeader) + header->count * sizeof(BookEntry)) {
+    file_.close();
+    return false;
+  }
+
+  entries_ = reinterpret_cast<const BookEntry *>(file_.data() + sizeof(BookHeader));
+  count_ = header->count;
+  return true;
+}
+
+bool OpeningBook::is_open() const { return entries_ != nullptr; }
+
+std::size_t OpeningBook::size() const { return count_; }
+
+std::vector<BookEntry> OpeningBook::lookup(uint64_t hash) const {
+  if (!is_open()) return {};
+
+  auto first = std::lower_bound(entries_, entries_ + count_, hash,
+                                [](const BookEntry &entry, uint64_t h) { return entry.hash < h; });
+  auto last = first;
+  while (last != entries_ + count_ && last->hash == hash) ++last;
+
+  return std::vector<BookEntry>(first, last);
+}
+
+bool OpeningBook::contains(uint64_t hash, uint16_t move) const {
+  for (const auto &entry : lookup(hash))
+    if (entry.move == move) return true;
+
+  return false;
+}
+
+std::vector<std::shared_ptr<Move>> OpeningBook::moves(const Game &game) const {
+  MoveFactory movemaker;
+  const Board &board = game.board();
+  std::vector<std::shared_ptr<Move>> result;
+
+  for (const auto &entry : lookup(game.hash())) {
+    auto move = movemaker.unpack(entry.move, board);
+    if (move) result.push_back(move);
+  }
+
+  return result;
+}
+
+// Book builder
+
+BookBuilder::BookBuilder() : games_(0) {}
+
+bool BookBuilder::add_game(const std::string &moves, int max_plies) {
+  Game game;
+  MoveFactory movemaker;
+  std::istringstream stream(moves);
+  std::string input;
+  games_++;
+
+  for (int ply = 0; ply < max_plies && stream >> input; ++ply) {
+    if (!movemaker.valid(input)) return false;
+
+    auto move = movemaker.parse_move(input);
+    if (!game.try_move(move)) return false;
+
+    counts_[{game.hash(), move->pack()}]++;
+    game.make_move(move);
+    game.swap();
+  }
+
+  return true;
+}
+
+std::size_t BookBuilder::games() const { return games_; }
+
+std::size_t BookBuilder::entries() const { return counts_.size(); }
+
+bool BookBuilder::write(const std::string &path) const {
+  std::vector<BookEntry> entries;
+  entries.reserve(counts_.size());
+
+  for (const auto &count : counts_) {
+    BookEntry entry{count.first.first, count.first.second, static_cast<uint16_t>(std::min<uint32_t>(count.second, 0xFFFF)),
+                    0};
+    entries.push_back(entry);
+  }
+
+  std::sort(entries.begin(), entries.end(), entry_order);
+
+  BookHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.count = entries.size();
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(BookEntry));
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,555 @@
+//===----------------------------------------------------------------------===//
+//
+// A small engine on top of `Game`: moves come from `Game::legal_moves`, are
+// made & taken back with `make_move`/`undo`, and scored by a negamax
+// alpha-beta search over material. Book moves (if a book is set) are played
+// without searching, and positions the game's tablebases cover are scored
+// exactly (distance to mate) instead of searched.
+//
+// How many positions the search visits depends mostly on move order, so
+// moves are sorted before searching: the best move from the transposition
+// table, then captures (MVV-LVA), then killer moves & the history table.
+// Null-move pruning, late move reductions & a quiescence search over
+// captures trade a little exactness for depth. Every heuristic can be
+// switched off through `EngineConfig` to measure what it saves.
+//
+// Searches can be cancelled from another thread, which pondering relies on:
+// the background search for the expected reply is stopped as soon as the
+// opponent plays something else.
+//
+//===----------------------------------------------------------------------===//
+
+#include "engine.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "book.h"
+#include "tablebase.h"
+
+namespace {
+
+int piece_value(char piece) {
+  switch (std::tolower(piece)) {
+    case 'p':
+      return 100;
+    case 'n':
+    case 'b':
+      return 300;
+    case 'r':
+      return 500;
+    case 'q':
+      return 900;
+  }
+  return 0;
+}
+
+struct Heuristic {
+  const char *name;
+  bool EngineConfig::*enabled;
+};
+
+const Heuristic kHeuristics[] = {
+    {"tt", &EngineConfig::hash_move}, {"mvv", &EngineConfig::mvv_lva},    {"killers", &EngineConfig::killers},
+    {"history", &EngineConfig::history}, {"null", &EngineConfig::null_move}, {"lmr", &EngineConfig::lmr},
+    {"qs", &EngineConfig::quiescence},
+};
+
+const size_t kTableSize = 1 << 16;  // transposition table entries
+
+// mate scores are stored relative to the node, so they stay right when reached over another path:
+int to_table(int score, int ply) {
+  if (score > Engine::kMateScore - 1000) return score + ply;
+  if (score < -Engine::kMateScore + 1000) return score - ply;
+  return score;
+}
+
+int from_table(int score, int ply) {
+  if (score > Engine::kMateScore - 1000) return score - ply;
+  if (score < -Engine::kMateScore + 1000) return score + ply;
+  return score;
+}
+
+// null moves are unsound in zugzwang, which mostly happens with only king & pawns left:
+bool has_pieces(const Game &game) {
+  for (const auto &row : game.board()) {
+    for (const auto &piece : row) {
+      char kind = piece ? std::tolower(piece->to_char()) : 'k';
+      if (kind != 'p' && kind != 'k' && piece->owner() == game.to_move()) return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+// Engine configuration
+
+std::string EngineConfig::name() const {
+  if (depth == 0) return "random";
+
+  std::string name = "depth=" + std::to_string(depth);
+  for (const auto &heuristic : kHeuristics)
+    if (!(this->*(heuristic.enabled))) name += std::string(",no-") + heuristic.name;
+  if (nodes) name += ",nodes=" + std::to_string(nodes);
+  if (movetime) name += ",movetime=" + std::to_string(movetime);
+  return name;
+}
+
+bool EngineConfig::parse(const std::string &spec, EngineConfig &config) {
+  std::vector<std::string> parts;
+  for (size_t start = 0, end = 0; end != std::string::npos; start = end + 1) {
+    end = spec.find(',', start);
+    parts.push_back(spec.substr(start, end == std::string::npos ? std::string::npos : end - start));
+  }
+
+  EngineConfig parsed;
+  if (parts[0] == "random") {
+    parsed.depth = 0;
+  } else {
+    if (parts[0].rfind("depth=", 0) != 0 || parts[0].size() == 6 || parts[0].size() > 8) return false;
+    if (!std::all_of(parts[0].begin() + 6, parts[0].end(), ::isdigit)) return false;
+
+    parsed.depth = std::stoi(parts[0].substr(6));
+    if (parsed.depth <= 0) return false;
+  }
+
+  // limits ("nodes=N") & heuristics: "lmr" switches one on, "no-lmr" off
+  for (size_t i = 1; i < parts.size(); ++i) {
+    size_t equals = parts[i].find('=');
+    if (equals != std::string::npos) {
+      std::string key = parts[i].substr(0, equals), value = parts[i].substr(equals + 1);
+      if (value.empty() || value.size() > 12 || !std::all_of(value.begin(), value.end(), ::isdigit)) return false;
+
+      if (key == "nodes")
+        parsed.nodes = std::stoull(value);
+      else if (key == "movetime")
+        parsed.movetime = std::stoll(value);
+      else
+        return false;
+      continue;
+    }
+
+    bool on = parts[i].rfind("no-", 0) != 0;
+    std::string name = on ? parts[i] : parts[i].substr(3);
+
+    auto heuristic = std::find_if(std::begin(kHeuristics), std::end(kHeuristics),
+                                  [&](const Heuristic &h) { return name == h.name; });
+    if (heuristic == std::end(kHeuristics)) return false;
+    parsed.*(heuristic->enabled) = on;
+  }
+
+  config = parsed;
+  return true;
+}
+
+// Engine
+
+Engine::Engine(EngineConfig config, uint32_t seed)
+    : config_(config),
+      rng_(seed),
+      nodes_(0),
+      killers_(),
+      history_(),
+      stop_(false),
+      cancel_(nullptr),
+      ponder_done_(false),
+      ponder_hash_(0),
+      ponder_hits_(0) {
+  if (config_.hash_move) table_.resize(kTableSize);
+}
+
+Engine::~Engine() { stop_pondering(); }
+
+// checked on entering every node, so a search stops within one node of its limits:
+bool Engine::stopped() const {
+  if (stop_.load(std::memory_order_relaxed) || (cancel_ && cancel_->load(std::memory_order_relaxed))) return true;
+  return (config_.nodes && nodes_ >= config_.nodes) || timer_.out_of_time();
+}
+
+void Engine::set_book(std::shared_ptr<const OpeningBook> book) { book_ = book; }
+
+const EngineConfig &Engine::config() const { return config_; }
+
+uint64_t Engine::nodes() const { return nodes_; }
+
+int Engine::evaluate(const Game &game) {
+  int score = 0;
+  const Board &board = game.board();
+
+  for (const auto &row : board) {
+    for (const auto &piece : row) {
+      if (!piece) continue;
+
+      int value = piece_value(piece->to_char());
+      score += (piece->owner() == game.to_move()) ? value : -value;
+    }
+  }
+
+  return score;
+}
+
+void Engine::order(std::vector<std::shared_ptr<Move>> &moves, const Game &game, uint16_t hash_move, int ply) const {
+  const Board &board = game.board();
+
+  auto priority = [&](const Move &move) {
+    uint16_t packed = move.pack();
+    if (config_.hash_move && hash_move != 0 && packed == hash_move) return 1 << 30;
+
+    if (move.has_capture()) {
+      if (!config_.mvv_lva) return 0;
+      // the king is the least welcome attacker, it may walk into a recapture:
+      int attacker = std::tolower(move.piece_char()) == 'k' ? 1000 : piece_value(move.piece_char());
+      return (1 << 20) + 10 * piece_value(board[move.to().row][move.to().col]->to_char()) - attacker / 100;
+    }
+
+    if (config_.killers && ply < kMaxPly && (packed == killers_[ply][0] || packed == killers_[ply][1])) return 1 << 19;
+    if (config_.history && !move.is_detonation())
+      return history_[move.from().row * 8 + move.from().col][move.to().row * 8 + move.to().col];
+    return 0;
+  };
+
+  std::vector<std::pair<int, std::shared_ptr<Move>>> ranked;
+  ranked.reserve(moves.size());
+  for (const auto &move : moves) ranked.emplace_back(priority(*move), move);
+
+  // stable, so moves of equal priority keep their (shuffled) order:
+  std::stable_sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+  for (size_t i = 0; i < moves.size(); ++i) moves[i] = ranked[i].second;
+}
+
+void Engine::remember_cutoff(const Move &move, int depth, int ply) {
+  if (config_.killers && ply < kMaxPly && killers_[ply][0] != move.pack()) {
+    killers_[ply][1] = killers_[ply][0];
+    killers_[ply][0] = move.pack();
+  }
+
+  if (config_.history && !move.is_detonation()) {
+    int &entry = history_[move.from().row * 8 + move.from().col][move.to().row * 8 + move.to().col];
+    entry += depth * depth;
+
+    // stays below the killer priority; halving keeps the proportions:
+    if (entry >= 1 << 18)
+      for (auto &from : history_)
+        for (auto &to : from) to /= 2;
+  }
+}
+
+int Engine::quiesce(Game &game, int alpha, int beta, int ply) {
+  if (stopped()) return 0;  // result is thrown away
+  nodes_++;
+
+  if (!game.kingpos(game.to_move()).valid()) return -kMateScore + ply;
+
+  // the player to move may stop capturing ("stand pat"):
+  int stand_pat = evaluate(game);
+  if (stand_pat >= beta) return beta;
+  alpha = std::max(alpha, stand_pat);
+
+  auto moves = game.captures();  // without generating the quiet moves
+  order(moves, game, 0, ply);
+
+  for (const auto &move : moves) {
+    game.make_move(move);
+    game.swap();
+    int score = -quiesce(game, -beta, -alpha, ply + 1);
+    game.undo();
+    game.swap();
+
+    if (stopped()) return 0;
+    if (score >= beta) return beta;
+    alpha = std::max(alpha, score);
+  }
+
+  return alpha;
+}
+
+int Engine::search(Game &game, int depth, int alpha, int beta, int ply, bool allow_null) {
+  if (stopped()) return 0;  // result is thrown away
+  nodes_++;
+
+  // a king lost in an explosion (Beirut variant) ends the game:
+  if (!game.kingpos(game.to_move()).valid()) return -kMateScore + ply;
+
+  // few pieces left: the tablebases know the exact result (bombs are not modeled there)
+  TbResult result;
+  const auto &tablebases = game.tablebases();
+  if (tablebases && !game.beirut_mode() && tablebases->probe(game.board(), game.to_move(), result)) {
+    if (result.wdl == Wdl::Draw) return 0;
+    return result.wdl == Wdl::Win ? kMateScore - ply - result.dtm : -kMateScore + ply + result.dtm;
+  }
+
+  if (depth <= 0) return config_.quiescence ? quiesce(game, alpha, beta, ply) : evaluate(game);
+
+  uint64_t hash = 0;
+  uint16_t hash_move = 0;
+  if (config_.hash_move) {
+    hash = game.hash();
+    const TTEntry &entry = table_[hash % table_.size()];
+
+    if (entry.hash == hash) {
+      hash_move = entry.move;
+      int score = from_table(entry.score, ply);
+
+      if (entry.depth >= depth) {
+        if (entry.bound == Bound::Exact) return std::max(alpha, std::min(beta, score));
+        if (entry.bound == Bound::Lower && score >= beta) return beta;
+        if (entry.bound == Bound::Upper && score <= alpha) return alpha;
+      }
+    }
+  }
+
+  bool in_check = game.in_check(game.to_move());
+
+  // null move: if passing still holds the opponent below beta, a real move will too
+  if (config_.null_move && allow_null && !in_check && depth >= 3 && has_pieces(game)) {
+    game.swap();
+    int score = -search(game, depth - 3, -beta, -beta + 1, ply + 1, false);
+    game.swap();
+
+    if (stopped()) return 0;
+    if (score >= beta) return beta;
+  }
+
+  auto moves = game.legal_moves();
+  if (moves.empty()) return in_check ? -kMateScore + ply : 0;  // mate or stalemate
+
+  order(moves, game, hash_move, ply);
+
+  int original_alpha = alpha;
+  uint16_t best = 0;
+
+  for (size_t i = 0; i < moves.size(); ++i) {
+    const auto &move = moves[i];
+    bool quiet = !move->has_capture() && !move->is_promotion() && !move->is_detonation();
+
+    game.make_move(move);
+    game.swap();
+
+    int score;
+    // late move reduction: moves sorted this far back rarely matter, so look at them shallower first
+    if (config_.lmr && i >= 3 && depth >= 3 && quiet && !in_check && !game.in_check(game.to_move())) {
+      score = -search(game, depth - 2, -alpha - 1, -alpha, ply + 1, true);
+      if (score > alpha) score = -search(game, depth - 1, -beta, -alpha, ply + 1, true);
+    } else {
+      score = -search(game, depth - 1, -beta, -alpha, ply + 1, true);
+    }
+
+    game.undo();
+    game.swap();
+
+    // a stopped search must not leave half-searched results in the table:
+    if (stopped()) return 0;
+
+    if (score >= beta) {
+      if (quiet) remember_cutoff(*move, depth, ply);
+      if (config_.hash_move)
+        table_[hash % table_.size()] = {hash, to_table(beta, ply), int8_t(depth), Bound::Lower, move->pack()};
+      return beta;
+    }
+
+    if (score > alpha) {
+      alpha = score;
+      best = move->pack();
+    }
+  }
+
+  if (config_.hash_move)
+    table_[hash % table_.size()] = {hash, to_table(alpha, ply), int8_t(depth),
+                                    alpha > original_alpha ? Bound::Exact : Bound::Upper, best};
+  return alpha;
+}
+
+std::shared_ptr<Move> Engine::best_move(Game &game, const std::atomic<bool> *cancel) {
+  if (ponder_thread_.joinable()) {
+    if (game.hash() == ponder_hash_) {
+      // ponder hit: the background search is the search we need, let it go on within this move's budget
+      TimeManager budget = time_budget(game);
+      while (!ponder_done_ && !(cancel && *cancel) && budget.next_iteration(false) && !budget.out_of_time())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      stop_pondering();
+
+      if (ponder_result_ && game.try_move(ponder_result_)) {
+        ponder_hits_++;
+        return ponder_result_;
+      }
+    } else {
+      stop_pondering();
+    }
+  }
+
+  cancel_ = cancel;
+  timer_ = time_budget(game);
+  auto move = search_root(game);
+  cancel_ = nullptr;
+  timer_ = TimeManager();
+  return move;
+}
+
+TimeManager Engine::time_budget(const Game &game) const {
+  TimeManager budget;
+  int64_t time_left = 0;
+  if (game.has_clock()) time_left = std::max<int64_t>(game.time_left(game.to_move()), -1);  // -1: flag fell
+
+  budget.start(time_left, game.has_clock() ? game.time_control().increment_ms : 0, config_.movetime);
+  return budget;
+}
+
+std::shared_ptr<Move> Engine::search_root(Game &game) {
+  nodes_ = 0;
+
+  if (book_) {
+    std::vector<std::shared_ptr<Move>> book_moves;
+    for (const auto &move : book_->moves(game))
+      if (game.try_move(move)) book_moves.push_back(move);  // guards against hash collisions
+
+    if (!book_moves.empty()) return book_moves[rng_() % book_moves.size()];
+  }
+
+  auto moves = game.legal_moves();
+  if (moves.empty()) return nullptr;
+
+  std::shuffle(moves.begin(), moves.end(), rng_);  // vary play between equally good moves
+  if (config_.depth == 0) return moves.front();
+
+  for (auto &ply : killers_) ply.fill(0);
+  for (auto &from : history_) from.fill(0);
+
+  // with a transposition table, shallower searches first fill it with good moves to try first;
+  // with limits, they make sure there is a move when the search has to stop:
+  bool iterate = config_.hash_move || config_.nodes || timer_.limited();
+  std::shared_ptr<Move> best = moves.front();
+  int best_score = 0;
+  bool unstable = false;
+
+  for (int depth = iterate ? 1 : config_.depth; depth <= config_.depth; ++depth) {
+    if (depth > 1 && !timer_.next_iteration(unstable)) break;
+
+    order(moves, game, best->pack(), 0);
+    std::shared_ptr<Move> iteration_best = moves.front();
+    int alpha = -kMateScore - 1;
+
+    for (const auto &move : moves) {
+      game.make_move(move);
+      game.swap();
+      int score = -search(game, depth - 1, -kMateScore - 1, -alpha, 1, true);
+      game.undo();
+      game.swap();
+
+      if (stopped()) break;
+      if (score > alpha) {
+        alpha = score;
+        iteration_best = move;
+      }
+    }
+
+    // a stopped iteration only counts if it is the first one:
+    if (stopped() && depth > 1) break;
+
+    // a new best move or a falling score call for more time:
+    unstable = depth > 1 && (iteration_best != best || alpha < best_score - 50);
+    best = iteration_best;
+    best_score = alpha;
+    if (stopped()) break;
+  }
+
+  return best;
+}
+
+// Analysis
+
+std::vector<MoveScore> Engine::analyze(Game &game, Field from, const std::atomic<bool> *cancel) {
+  stop_pondering();
+  nodes_ = 0;
+
+  std::vector<MoveScore> scores;
+  for (const auto &move : from.valid() ? game.legal_moves(from) : game.legal_moves()) scores.push_back({move, 0});
+  if (scores.empty() || config_.depth == 0) return scores;
+
+  for (auto &ply : killers_) ply.fill(0);
+  for (auto &from_square : history_) from_square.fill(0);
+  cancel_ = cancel;
+  timer_.start(0, 0, config_.movetime);  // no clock, analysis is not a move in the game
+
+  for (int depth = 1; depth <= config_.depth; ++depth) {
+    if (depth > 1 && !timer_.next_iteration(false)) break;
+    std::vector<MoveScore> iteration = scores;
+
+    for (auto &entry : iteration) {
+      int alpha = depth > 1 ? entry.score - kAspiration : -kMateScore - 1;
+      int beta = depth > 1 ? entry.score + kAspiration : kMateScore + 1;
+
+      game.make_move(entry.move);
+      game.swap();
+      int score = -search(game, depth - 1, -beta, -alpha, 1, true);
+      if (!stopped() && (score <= alpha || score >= beta))  // outside the window: only a bound, search again
+        score = -search(game, depth - 1, -kMateScore - 1, kMateScore + 1, 1, true);
+      game.undo();
+      game.swap();
+
+      if (stopped()) break;
+      entry.score = score;
+    }
+
+    if (stopped() && depth > 1) break;
+
+    // best first, so the next depth finds the table filled with the lines that matter:
+    std::stable_sort(iteration.begin(), iteration.end(),
+                     [](const MoveScore &a, const MoveScore &b) { return a.score > b.score; });
+    scores = iteration;
+    if (stopped()) break;
+  }
+
+  cancel_ = nullptr;
+  timer_ = TimeManager();
+  return scores;
+}
+
+// Pondering
+
+bool Engine::ponder(const Game &game) {
+  stop_pondering();
+  if (!config_.hash_move || config_.depth == 0) return false;
+
+  Game position = game;  // the background search works on its own copy
+  auto reply = expected_reply(position);
+  if (!reply) return false;
+
+  position.make_move(reply);
+  position.swap();
+
+  ponder_hash_ = position.hash();
+  ponder_result_ = nullptr;
+  ponder_done_ = false;
+  ponder_thread_ = std::thread([this, position]() mutable {
+    ponder_result_ = search_root(position);
+    ponder_done_ = true;
+  });
+  return true;
+}
+
+std::shared_ptr<Move> Engine::expected_reply(Game &game) const {
+  if (table_.empty()) return nullptr;
+
+  uint64_t hash = game.hash();
+  const TTEntry &entry = table_[hash % table_.size()];
+  if (entry.hash != hash || entry.move == 0) return nullptr;
+
+  auto move = MoveFactory().unpack(entry.move, game.board());
+  return move && game.try_move(move) ? move : nullptr;
+}
+
+uint64_t Engine::ponder_hits() const { return ponder_hits_; }
+
+void Engine::stop_pondering() {
+  if (!ponder_thread_.joinable()) return;
+
+  stop_ = true;
+  ponder_thread_.join();
+  stop_ = false;
+}
@@ -0,0 +1,54 @@
+//===----------------------------------------------------------------------===//
+//
+// Input is read on its own thread & handed to the game loop as events, so the
+// loop never sits in a blocking `std::getline` while there is other work (an
+// engine move coming in). The reader thread is detached: at the end of the
+// game it may still be waiting for a line that never comes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "events.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+void EventQueue::push(Event event) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.push_back(std::move(event));
+  }
+  ready_.notify_all();
+}
+
+Event EventQueue::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_.wait(lock, [this] { return !events_.empty(); });
+
+  Event event = std::move(events_.front());
+  events_.pop_front();
+  return event;
+}
+
+bool EventQueue::wait_line(std::string &line) {
+  auto is_input = [](const Event &event) { return event.kind != Event::Kind::EngineMove; };
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_.wait(lock, [&] { return std::any_of(events_.begin(), events_.end(), is_input); });
+
+  auto input = std::find_if(events_.begin(), events_.end(), is_input);
+  if (input->kind == Event::Kind::EndOfInput) return false;  // stays queued for the game loop
+
+  line = std::move(input->line);
+  events_.erase(input);
+  return true;
+}
+
+void read_input(std::shared_ptr<EventQueue> queue) {
+  std::thread([queue] {
+    std::string line;
+    while (std::getline(std::cin, line)) queue->push({Event::Kind::Line, line, nullptr});
+    queue->push({Event::Kind::EndOfInput, "", nullptr});
+  }).detach();
+}
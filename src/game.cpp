@@ -9,14 +9,22 @@
 #include "game.h"
 
 #include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <memory>
-#include <regex>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "book.h"
+#include "movegen.h"
+#include "stats.h"
+#include "tablebase.h"
+#include "zobrist.h"
+
 // color codes
 #define WHITE "\033[1;37m"
 #define BLACK "\033[1;30m"
@@ -26,30 +34,29 @@
 #define CYAN_BG "\033[46m"
 #define YELLOW_BG "\033[1;43m"
 #define RED_BG "\033[1;41m"
+#define GREEN_BG "\033[42m"
 #define RESET_BG "\033[49m"
 
 #define CLEAR_SCREEN "\033[H\033[J"
 
+namespace {
+
+const char kStartPosition[] = "rnbqkbnrpppppppp                                PPPPPPPPRNBQKBNR";
+
+bool script_mode = false;  // see `Game::set_script_mode`
+
+void clear_screen() {
+  if (!script_mode) std::cout << CLEAR_SCREEN;
+}
+
+}  // namespace
+
 // initial board state if none is provided:
 Board Game::init_board() const {
   Board board(8, std::vector<std::shared_ptr<Piece>>(8, nullptr));
-  board[0] = {std::make_shared<Rook>(Player::Black),   std::make_shared<Knight>(Player::Black),
-              std::make_shared<Bishop>(Player::Black), std::make_shared<Queen>(Player::Black),
-              std::make_shared<King>(Player::Black),   std::make_shared<Bishop>(Player::Black),
-              std::make_shared<Knight>(Player::Black), std::make_shared<Rook>(Player::Black)};
 
-  for (std::size_t i = 0; i < board[1].size(); i++) {
-    board[1][i] = std::make_shared<Pawn>(Player::Black);
-  }
-
-  for (std::size_t i = 0; i < board[6].size(); i++) {
-    board[6][i] = std::make_shared<Pawn>(Player::White);
-  }
-
-  board[7] = {std::make_shared<Rook>(Player::White),   std::make_shared<Knight>(Player::White),
-              std::make_shared<Bishop>(Player::White), std::make_shared<Queen>(Player::White),
-              std::make_shared<King>(Player::White),   std::make_shared<Bishop>(Player::White),
-              std::make_shared<Knight>(Player::White), std::make_shared<Rook>(Player::White)};
+  for (int i = 0; i < 64; ++i)
+    if (kStartPosition[i] != ' ') board[i / 8][i % 8] = PieceFactory::make_piece(kStartPosition[i]);
 
   return board;
 }
@@ -57,31 +64,49 @@ Board Game::init_board() const {
 /* Next to initializing the board we also keep track of the kings' positions.
    This means we won't have to look for them later if we test check & checkmate.
  */
-Game::Game() : state_(init_board()) {}
+Game::Game() : state_(init_board()), current_player_(Player::White), beirut_mode_(false), time_left_ms_() {}
 
 // Initializing a game from a provided board state
-Game::Game(const std::string &input) {
+Game::Game(const std::string &input) : beirut_mode_(false), time_left_ms_() {
+  if (input.size() != 64)
+    throw std::invalid_argument("position needs 64 characters, got " + std::to_string(input.size()));
+
   Board board(8, std::vector<std::shared_ptr<Piece>>(8, nullptr));
-  PieceFactory piecemaker;
 
   for (int i = 0; i < 64; ++i) {
     char c = input[i];
     int row = i / 8;
     int col = i % 8;
 
-    if (c != ' ') board[row][col] = piecemaker.make_piece(c);
+    if (c == ' ') continue;
+    board[row][col] = PieceFactory::make_piece(c);
+    if (!board[row][col]) throw std::invalid_argument(std::string("unknown piece '") + c + "' in position");
   }
 
   state_ = board;
   current_player_ = Player::White;  // white always starts, even when reading from file
 }
 
-Board Game::board() const { return state_; }
+const Board &Game::board() const { return state_; }
+
+std::string Game::position() const {
+  std::string position(64, ' ');
+
+  for (int row = 0; row < 8; ++row)
+    for (int col = 0; col < 8; ++col)
+      if (state_[row][col]) position[row * 8 + col] = state_[row][col]->to_char();
+
+  return position;
+}
+
+void Game::set_tablebases(std::shared_ptr<const Tablebases> tablebases) { tablebases_ = tablebases; }
+
+const std::shared_ptr<const Tablebases> &Game::tablebases() const { return tablebases_; }
 
 void Game::print_board(bool char_view) const {
   const std::string cols = "    a  b  c  d  e  f  g  h   ";
 
-  std::cout << CLEAR_SCREEN;
+  clear_screen();
   std::cout << GREEN << cols << RESET << '\n';
   for (size_t i = 0; i < 8; ++i) {
     std::cout << GREEN << " " << 8 - i << RESET << ' ';
@@ -106,42 +131,211 @@ void Game::print_board(bool char_view) const {
 void Game::show(bool char_view) const {
   // board, player status, commands & input prompt:
   print_board(char_view);
+  print_status();
+}
+
+void Game::print_status() const {
+  auto clock = [this](Player p) {
+    int64_t seconds = std::max<int64_t>(time_left(p), 0) / 1000;
+    std::string ss = std::to_string(seconds % 60);
+    return std::to_string(seconds / 60) + ":" + (ss.size() < 2 ? "0" : "") + ss;
+  };
+
   std::cout << (in_check(to_move()) ? "CHECK! " : "") << (to_move() == Player::White ? "White" : "Black")
-            << "'s turn.\n"
-            << "Commands: (:n)ew game (:u)ndo (:q)uit (:m)oves (:t)oggle character mode\n"
+            << "'s turn.";
+  if (has_clock()) std::cout << " (White " << clock(Player::White) << " | Black " << clock(Player::Black) << ')';
+  std::cout << "\nCommands: (:n)ew game (:u)ndo (:q)uit (:m)oves (:t)oggle character mode (:s)tats (:c)lock\n"
             << "\033[43m" << "Input>" << RESET_BG;
 }
 
+void Game::set_script_mode(bool on) { script_mode = on; }
+
 Player Game::to_move() const { return current_player_; }
 
+uint64_t Game::hash() const { return position_hash(state_, current_player_); }
+
 void Game::swap() {
   current_player_ == Player::White ? current_player_ = Player::Black : current_player_ = Player::White;
 }
 
+// Undo records
+
+void UndoRecord::save(const Board &board, Field field) {
+  if (blast)
+    blast->emplace_back(field, board[field.row][field.col]);
+  else
+    squares[count++] = {field, board[field.row][field.col]};
+}
+
 void Game::make_move(std::shared_ptr<Move> move) {
-  history_.push(state_);
+  STATS_SCOPE(Counter::MakeMove);
+  UndoRecord record;
 
   Field from = move->from();
   Field to = move->to();
 
+  // Beirut variant: detonation clears the 3x3 window around the carrier
+  if (move->is_detonation()) {
+    record.blast = std::make_unique<std::vector<UndoRecord::Square>>();
+    record.blast->reserve(9);
+    for (int i = std::max(0, from.row - 1); i <= std::min(7, from.row + 1); ++i) {
+      for (int j = std::max(0, from.col - 1); j <= std::min(7, from.col + 1); ++j) {
+        record.save(state_, Field(i, j));
+        state_[i][j] = nullptr;
+      }
+    }
+
+    history_ = std::make_shared<const HistoryNode>(
+        HistoryNode{std::move(record), move, current_player_, ply() + 1, history_});
+    return;
+  }
+
+  record.save(state_, from);
+  record.save(state_, to);
+  history_ = std::make_shared<const HistoryNode>(
+      HistoryNode{std::move(record), move, current_player_, ply() + 1, history_});
+
   state_[to.row][to.col] = state_[from.row][from.col];
   state_[from.row][from.col] = nullptr;
 
   // handle promotion:
-  if (move->is_promotion()) {
-    auto piecemaker = std::make_unique<PieceFactory>();
-    state_[to.row][to.col] = piecemaker->make_piece(move->promote_to());
-  }
+  if (move->is_promotion()) state_[to.row][to.col] = PieceFactory::make_piece(move->promote_to());
 }
 
 void Game::undo() {
-  auto prev_state = history_.top();
-  history_.pop();
+  STATS_SCOPE(Counter::Undo);
+  if (!history_) return;  // nothing to take back
+
+  const UndoRecord &record = history_->record;
+
+  if (record.blast)
+    for (auto square = record.blast->rbegin(); square != record.blast->rend(); ++square)
+      state_[square->first.row][square->first.col] = square->second;
+
+  for (int i = record.count - 1; i >= 0; --i) {
+    const auto &square = record.squares[i];
+    state_[square.first.row][square.first.col] = square.second;
+  }
 
-  state_ = prev_state;
+  history_ = history_->parent;
+}
+
+int Game::ply() const { return history_ ? history_->ply : 0; }
+
+std::vector<std::shared_ptr<Move>> Game::moves_played() const {
+  std::vector<std::shared_ptr<Move>> moves;
+  for (auto node = history_; node; node = node->parent) moves.push_back(node->move);
+
+  std::reverse(moves.begin(), moves.end());
+  return moves;
+}
+
+void Game::jump_to(int ply) {
+  while (history_ && history_->ply > ply) {
+    current_player_ = history_->mover;
+    undo();
+  }
+}
+
+Game Game::fork(int ply) const {
+  Game copy(*this);  // copies the board's piece pointers, shares the history
+  copy.jump_to(ply);
+  return copy;
+}
+
+// Memory
+
+namespace {
+
+const uint64_t kControlBlock = 16;  // shared counts of a `std::make_shared` allocation
+
+}  // namespace
+
+MemoryUsage Game::memory_usage() const {
+  MemoryUsage usage;
+  std::vector<const Piece *> heap_pieces;  // bomb carriers, counted once however often they are referenced
+  auto count_piece = [&](const std::shared_ptr<Piece> &piece) {
+    if (!piece || piece.use_count() == 0) return;  // empty or a prototype (owns nothing)
+    if (std::find(heap_pieces.begin(), heap_pieces.end(), piece.get()) != heap_pieces.end()) return;
+
+    heap_pieces.push_back(piece.get());
+    usage.pieces += sizeof(Piece) + kControlBlock;  // the piece classes add no members
+  };
+
+  usage.board = sizeof(state_) + state_.capacity() * sizeof(state_[0]);
+  for (const auto &row : state_) {
+    usage.board += row.capacity() * sizeof(row[0]);
+    for (const auto &piece : row) count_piece(piece);
+  }
+
+  usage.history = sizeof(history_);
+  for (auto node = history_; node; node = node->parent) {
+    usage.history += sizeof(HistoryNode) + kControlBlock;
+    if (node->move) usage.history += sizeof(Move) + kControlBlock;
+    for (int i = 0; i < node->record.count; ++i) count_piece(node->record.squares[i].second);
+    if (!node->record.blast) continue;
+
+    usage.history += sizeof(*node->record.blast) + node->record.blast->capacity() * sizeof(UndoRecord::Square);
+    for (const auto &square : *node->record.blast) count_piece(square.second);
+  }
+
+  return usage;
+}
+
+uint64_t PackedGame::bytes() const {
+  return sizeof(PackedGame) + start.capacity() + moves.capacity() * sizeof(moves[0]);
+}
+
+PackedGame Game::pack() const {
+  Game start = fork(0);
+
+  PackedGame packed;
+  packed.start = start.position();
+  packed.bomb_carriers = 0;
+  for (int row = 0; row < 8; ++row)
+    for (int col = 0; col < 8; ++col)
+      if (start.state_[row][col] && start.state_[row][col]->carries_bomb())
+        packed.bomb_carriers |= square_bit(Field(row, col));
+
+  packed.first_mover = start.current_player_;
+  packed.to_move = current_player_;
+  packed.beirut_mode = beirut_mode_;
+
+  packed.moves.resize(ply());
+  size_t i = packed.moves.size();
+  for (auto node = history_; node; node = node->parent) packed.moves[--i] = node->move->pack();
+
+  packed.time_control = time_control_;
+  packed.time_left_ms = time_left_ms_;
+  packed.turn_start = turn_start_;
+  return packed;
+}
+
+Game Game::unpack(const PackedGame &packed) {
+  Game game(packed.start);
+  for (int row = 0; row < 8; ++row)
+    for (int col = 0; col < 8; ++col)
+      if (packed.bomb_carriers & square_bit(Field(row, col)))
+        game.state_[row][col] = PieceFactory::make_bomb_carrier(game.state_[row][col]->to_char());
+
+  if (packed.beirut_mode) game.enable_beirut_mode();
+  game.current_player_ = packed.first_mover;
+
+  MoveFactory movemaker;
+  for (uint16_t move : packed.moves) {
+    game.make_move(movemaker.unpack(move, game.state_));
+    game.swap();
+  }
+
+  game.current_player_ = packed.to_move;
+  game.time_control_ = packed.time_control;
+  game.time_left_ms_ = packed.time_left_ms;
+  game.turn_start_ = packed.turn_start;
+  return game;
 }
 
 bool Game::substantively_valid(std::shared_ptr<Move> move, bool threat_check = false) const {
+  STATS_SCOPE(Counter::SubstantivelyValid);
   /* The threat_check flag overrides ownership tests, so we can
   check whether a king is in check regardless of whose turn it is. */
   Field from = move->from();
@@ -155,6 +349,11 @@ bool Game::substantively_valid(std::shared_ptr<Move> move, bool threat_check = f
     return false;  // no piece at starting loc (also prevents nullptr deref in
                    // later checks)
 
+  // Beirut variant: the player's own bomb carrier may detonate at any time
+  if (move->is_detonation())
+    return beirut_mode_ && piece_at_start->carries_bomb() && piece_at_start->owner() == current_player_ &&
+           ref_piece == piece_at_start->to_char();
+
   if (!threat_check && (current_player_ != piece_at_start->owner()))
     return false;  // piece does not belong to moving player
 
@@ -162,10 +361,16 @@ bool Game::substantively_valid(std::shared_ptr<Move> move, bool threat_check = f
 
   if (move->has_capture() && !piece_at_dest) return false;  // marked as capture but no piece at dest
 
+  if (!move->has_capture() && piece_at_dest) return false;  // not marked as capture, but the square is taken
+
   if (!threat_check && (move->has_capture() && piece_at_dest->owner() == current_player_))
     return false;  // piece to capture belongs to moving player
 
-  if (!piece_at_start->valid(move, state_)) return false;  // piece cannot move like this
+  // piece cannot move like this (one switch on the kind, no virtual `Piece::valid` call):
+  PieceKind kind = piece_kind(ref_piece);
+  bool reachable = piece_at_start->owner() == Player::White ? reaches<Player::White>(kind, *move, state_)
+                                                            : reaches<Player::Black>(kind, *move, state_);
+  if (!reachable) return false;
 
   // Check pawn promotion: (this should ideally be done in Pawn::valid)
   if (move->is_promotion()) {
@@ -186,6 +391,60 @@ bool Game::substantively_valid(std::shared_ptr<Move> move, bool threat_check = f
   return true;  // If none of the above conditions failed, the move is valid
 }
 
+// Clock
+
+std::string TimeControl::name() const {
+  return std::to_string(base_ms / 60000) + "+" + std::to_string(increment_ms / 1000);
+}
+
+bool TimeControl::parse(const std::string &spec, TimeControl &control) {
+  size_t plus = spec.find('+');
+  if (plus == std::string::npos || plus == 0 || plus + 1 == spec.size() || spec.size() > 12) return false;
+  if (!std::all_of(spec.begin(), spec.begin() + plus, ::isdigit)) return false;
+  if (!std::all_of(spec.begin() + plus + 1, spec.end(), ::isdigit)) return false;
+
+  TimeControl parsed;
+  parsed.base_ms = std::stoll(spec.substr(0, plus)) * 60000;
+  parsed.increment_ms = std::stoll(spec.substr(plus + 1)) * 1000;
+  if (parsed.base_ms == 0) return false;
+
+  control = parsed;
+  return true;
+}
+
+void Game::set_time_control(TimeControl control) {
+  time_control_ = control;
+  time_left_ms_.fill(control.base_ms);
+  turn_start_ = std::chrono::steady_clock::now();
+}
+
+const TimeControl &Game::time_control() const { return time_control_; }
+
+bool Game::has_clock() const { return time_control_.base_ms > 0; }
+
+int64_t Game::time_left(Player p) const {
+  int64_t left = time_left_ms_[static_cast<int>(p)];
+  if (p != current_player_ || !has_clock()) return left;
+
+  auto running = std::chrono::steady_clock::now() - turn_start_;
+  return left - std::chrono::duration_cast<std::chrono::milliseconds>(running).count();
+}
+
+void Game::punch_clock() {
+  if (!has_clock()) return;
+
+  Player mover = current_player_ == Player::White ? Player::Black : Player::White;
+  auto now = std::chrono::steady_clock::now();
+  int64_t used = std::chrono::duration_cast<std::chrono::milliseconds>(now - turn_start_).count();
+
+  int64_t &left = time_left_ms_[static_cast<int>(mover)];
+  left -= used;
+  if (left > 0) left += time_control_.increment_ms;  // no increment after the flag fell
+  turn_start_ = now;
+}
+
+bool Game::flagged(Player p) const { return has_clock() && time_left(p) <= 0; }
+
 Field Game::kingpos(Player p) const {
   char c = (p == Player::White ? 'K' : 'k');
 
@@ -206,36 +465,39 @@ Field Game::kingpos(Player p) const {
 }
 
 bool Game::in_check(Player p) const {
+  STATS_SCOPE(Counter::InCheck);
   Field king_field = kingpos(p);
+  if (!king_field.valid()) return false;  // king blown up (Beirut variant), see `checkmate`
 
-  // find opposing pieces & see if they can perform a valid capture move towards
-  // the king:
-  for (int row = 0; row < 8; ++row) {
-    for (int col = 0; col < 8; ++col) {
-      if (state_[row][col]) {
-        if (state_[row][col]->owner() != p) {
-          auto current_piece = state_[row][col];
-          auto king_attack = std::make_shared<Move>(current_piece->to_char(), Field(row, col), king_field, true);
-
-          // if piece can perform valid capture move on king, king is in check
-          // (mark as threat_check):
-          if (substantively_valid(king_attack, true)) return true;
-        }
-      }
-    }
-  }
+  // the king is in check if it stands on a square attacked by the opponent:
+  return (attacks(p == Player::White ? Player::Black : Player::White) & square_bit(king_field)) != 0;
+}
+
+Bitboard Game::attacks(Player by) const { return attacked_squares(state_, by); }
+
+Bitboard Game::king_escapes(Player p) const {
+  Field king_field = kingpos(p);
+  if (!king_field.valid()) return 0;
 
-  return false;  // we could not find any piece that threatens the king
+  /* The king is taken off the board first, otherwise it would shadow the
+  squares behind it from a slider that is checking it along a line. */
+  Bitboard king = square_bit(king_field);
+  Player opponent = p == Player::White ? Player::Black : Player::White;
+  Bitboard danger = attacked_squares(state_, opponent, occupancy(state_) & ~king);
+
+  return king_attacks(king) & ~pieces_of(state_, p) & ~danger;
 }
 
 // Move probieren & zurücksetzen (kann benutzt werden um
 // zu prüfen ob der Zug den aktuellen Spieler Schach setzt)
 bool Game::try_move(std::shared_ptr<Move> move) {
+  STATS_SCOPE(Counter::TryMove);
   if (!substantively_valid(move, false)) return false;
 
   make_move(move);
 
-  if (in_check(current_player_)) {
+  // a detonation must not take the own king with it:
+  if (!kingpos(current_player_).valid() || in_check(current_player_)) {
     undo();
     return false;
   }
@@ -244,8 +506,24 @@ bool Game::try_move(std::shared_ptr<Move> move) {
   return true;
 }
 
-// Dumme brute-force Lösung für Schachmatt
+namespace {
+
+// squares strictly between two squares on a line (row, column or diagonal), 0 if they are not on one
+Bitboard between(Field a, Field b) {
+  int dr = (b.row > a.row) - (b.row < a.row);
+  int dc = (b.col > a.col) - (b.col < a.col);
+  if (a.row != b.row && a.col != b.col && std::abs(b.row - a.row) != std::abs(b.col - a.col)) return 0;
+
+  Bitboard squares = 0;
+  for (Field f(a.row + dr, a.col + dc); f.row != b.row || f.col != b.col; f = Field(f.row + dr, f.col + dc))
+    squares |= square_bit(f);
+  return squares;
+}
+
+}  // namespace
+
 bool Game::checkmate(Player p) {
+  STATS_SCOPE(Counter::Checkmate);
   /*
   This first check is neccessitated by the Beirut-variant, where
   the king might be "blown up" without prior check, and thus may
@@ -256,23 +534,53 @@ bool Game::checkmate(Player p) {
   Field king = kingpos(p);
   if (!king.valid()) return true;
 
+  // few pieces left: the tablebases know the exact result (bombs are not modeled there)
+  TbResult result;
+  if (tablebases_ && !beirut_mode_ && tablebases_->probe(state_, p, result))
+    return result.wdl == Wdl::Loss && result.dtm == 0;
+
   // and then from here we proceed "normally"
   if (!in_check(p)) return false;  // cannot be checkmate if not in check
 
-  // alle Figuren des Spielers finden:
+  // Beirut variant: blowing up the attacker (or the opposing king) is a way out
+  auto detonation = bomb_move(p);
+  if (detonation && p == current_player_ && try_move(detonation)) return false;
+
+  // the king's way out is read off the attack map in one go:
+  if (king_escapes(p)) return false;
+
+  /* Any other piece can only help by taking the checking piece or by
+  stepping in between, so only those squares are tried (none against a
+  double check). */
+  Bitboard checkers = 0;
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      const auto &piece = state_[row][col];
+      if (piece && piece->owner() != p && (piece_moves(state_, Field(row, col)) & square_bit(king)))
+        checkers |= square_bit(Field(row, col));
+    }
+  }
+  if (checkers & (checkers - 1)) return true;
+
+  Bitboard evasions = checkers;
+  for (int row = 0; row < 8; ++row)
+    for (int col = 0; col < 8; ++col)
+      if (checkers & square_bit(Field(row, col))) evasions |= between(king, Field(row, col));
+
+  // alle anderen Figuren des Spielers finden:
   for (int row = 0; row < 8; ++row) {
     for (int col = 0; col < 8; ++col) {
       auto piece = state_[row][col];
-      if (!piece || piece->owner() != p) continue;
+      if (!piece || piece->owner() != p || (row == king.row && col == king.col)) continue;
 
-      // alle möglichen moves generieren:
-      for (int r = 0; r < 8; ++r) {
+      Bitboard to = piece_moves(state_, Field(row, col)) & evasions;
+      for (int r = 0; r < 8 && to; ++r) {
         for (int c = 0; c < 8; ++c) {
-          if (r == row && c == col) continue;  // Skip the same square
+          if (!(to & square_bit(Field(r, c)))) continue;
 
           auto move = std::make_shared<Move>(piece->to_char(), Field(row, col), Field(r, c), state_[r][c] != nullptr);
 
-          // einfach ausprobieren & dann schauen ob Spieler noch im Schach:
+          // ausprobieren & dann schauen ob Spieler noch im Schach (z.B. gefesselte Figur):
           if (try_move(move)) {
             return false;  // At least one move is possible → Not checkmate
           }
@@ -284,13 +592,213 @@ bool Game::checkmate(Player p) {
   return true;  // keine erlaubten moves
 }
 
-void Game::print_moves(const std::string &input, const bool char_view) {
+template <Player P>
+void Game::generate_moves(Field only, Bitboard targets, bool captures_only,
+                          std::vector<std::shared_ptr<Move>> &moves) {
+  constexpr Player kOpponent = P == Player::White ? Player::Black : Player::White;
+  Field king = kingpos(P);
+  if (!king.valid()) return;  // blown up, no move is valid (see `try_move`)
+
+  Bitboard occupied = occupancy(state_);
+  Bitboard own = pieces_of(state_, P);
+  Bitboard king_bit = square_bit(king);
+  if (captures_only) targets &= occupied & ~own;
+
+  /* Out of check, only a piece in one of the king's lines can expose it
+  (if it is pinned), so only its moves are tried on the board; the king's
+  own moves are read off the attack map. */
+  bool check = (attacked_squares(state_, kOpponent, occupied) & king_bit) != 0;
+  Bitboard exposing = check ? ~Bitboard(0) : rook_attacks(king_bit, occupied) | bishop_attacks(king_bit, occupied);
+
+  auto king_safe_after = [&](Field from, Field to) {
+    auto &source = state_[from.row][from.col];
+    auto &target = state_[to.row][to.col];
+    std::shared_ptr<Piece> taken = std::move(target);  // moved around, not copied: no reference counting
+    target = std::move(source);
+    bool safe = !(attacked_squares(state_, kOpponent) & king_bit);
+    source = std::move(target);
+    target = std::move(taken);
+    return safe;
+  };
+
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      if (only.valid() && (row != only.row || col != only.col)) continue;
+      const auto &piece = state_[row][col];
+      if (!piece || piece->owner() != P) continue;
+
+      Field from(row, col);
+      char piece_char = piece->to_char();
+      PieceKind kind = piece_kind(piece_char);
+      Bitboard bit = square_bit(from);
+      bool king_move = kind == PieceKind::King;
+
+      Bitboard to = (king_move ? king_escapes(P) : destinations<P>(kind, bit, occupied, own)) & targets;
+      bool trial = !king_move && (exposing & bit);
+      bool promotes = kind == PieceKind::Pawn && !captures_only && (to & kPromotionRow<P>);
+
+      for (int square = 0; to && square < 64; ++square) {
+        if (!(to & (Bitboard(1) << square))) continue;
+
+        Field dest(square / 8, square % 8);
+        if (trial && !king_safe_after(from, dest)) continue;
+
+        bool is_capture = (occupied & (Bitboard(1) << square)) != 0;
+        moves.push_back(std::make_shared<Move>(piece_char, from, dest, is_capture));
+        if (!promotes) continue;
+
+        // pawns reaching the last row may also promote:
+        for (char promote_to : {'Q', 'R', 'B', 'N'}) {
+          if (P == Player::Black) promote_to = std::tolower(promote_to);
+          moves.push_back(std::make_shared<Move>(piece_char, from, dest, is_capture, promote_to));
+        }
+      }
+
+      // the bomb carrier can also blow up:
+      if (!captures_only && piece->carries_bomb()) {
+        auto detonation = std::make_shared<Move>(piece_char, from);
+        if (try_move(detonation)) moves.push_back(detonation);
+      }
+    }
+  }
+}
+
+std::vector<std::shared_ptr<Move>> Game::legal_moves() { return legal_moves(Field()); }
+
+std::vector<std::shared_ptr<Move>> Game::legal_moves(Field from) {
+  std::vector<std::shared_ptr<Move>> moves;
+  if (current_player_ == Player::White)
+    generate_moves<Player::White>(from, ~Bitboard(0), false, moves);
+  else
+    generate_moves<Player::Black>(from, ~Bitboard(0), false, moves);
+  return moves;
+}
+
+std::vector<std::shared_ptr<Move>> Game::captures() {
+  std::vector<std::shared_ptr<Move>> moves;
+  if (current_player_ == Player::White)
+    generate_moves<Player::White>(Field(), ~Bitboard(0), true, moves);
+  else
+    generate_moves<Player::Black>(Field(), ~Bitboard(0), true, moves);
+  return moves;
+}
+
+Bitboard Game::targets(Field from) {
+  Bitboard to = 0;
+  for (const auto &move : legal_moves(from))
+    if (!move->is_detonation()) to |= square_bit(move->to());
+  return to;
+}
+
+uint64_t Game::perft(int depth) {
+  if (depth == 0) return 1;
+
+  auto moves = legal_moves();
+  if (depth == 1) return moves.size();
+
+  Player mover = current_player_;
+  uint64_t nodes = 0;
+  for (const auto &move : moves) {
+    make_move(move);
+    swap();
+    nodes += perft(depth - 1);
+    undo();
+    current_player_ = mover;
+  }
+  return nodes;
+}
+
+std::vector<std::shared_ptr<Move>> Game::checking_moves() {
+  std::vector<std::shared_ptr<Move>> moves;
+  Player me = current_player_;
+  Player opponent = me == Player::White ? Player::Black : Player::White;
+  Field king = kingpos(opponent);
+  if (!king.valid()) return moves;
+
+  /* A piece gives check directly from the squares its kind attacks the
+  king from (a pawn: where a pawn of the other colour would capture), or
+  by uncovering a slider; only pieces in the king's lines can do the
+  latter, and only they (and promotions & detonations) try every move. */
+  Bitboard occupied = occupancy(state_);
+  Bitboard king_lines = piece_attacks('q', king, occupied);
+
+  auto keep_if_check = [&](std::shared_ptr<Move> move) {
+    make_move(move);
+    bool check = !kingpos(opponent).valid() || in_check(opponent);
+    bool legal = kingpos(me).valid() && !in_check(me);
+    undo();
+    if (check && legal) moves.push_back(move);
+  };
+
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      auto piece = state_[row][col];
+      if (!piece || piece->owner() != me) continue;
+
+      Field from(row, col);
+      char kind = piece->to_char();
+      bool pawn = std::tolower(kind) == 'p';
+      char checker = pawn ? (me == Player::White ? 'p' : 'P') : kind;  // the king's view of a pawn is reversed
+
+      Bitboard to = piece_moves(state_, from);
+      int last_row = me == Player::White ? 0 : 7;
+      bool promotes = pawn && from.row == last_row + (me == Player::White ? 1 : -1);
+      if (!(king_lines & square_bit(from)) && !promotes) to &= piece_attacks(checker, king, occupied);
+
+      for (int r = 0; r < 8 && to; ++r) {
+        for (int c = 0; c < 8; ++c) {
+          if (!(to & square_bit(Field(r, c)))) continue;
+
+          bool captures = state_[r][c] != nullptr;
+          keep_if_check(std::make_shared<Move>(kind, from, Field(r, c), captures));
+          if (!promotes) continue;
+
+          for (char promote_to : std::string("QRBN")) {
+            if (me == Player::Black) promote_to = std::tolower(promote_to);
+            keep_if_check(std::make_shared<Move>(kind, from, Field(r, c), captures, promote_to));
+          }
+        }
+      }
+
+      if (beirut_mode_ && piece->carries_bomb()) keep_if_check(std::make_shared<Move>(kind, from));
+    }
+  }
+
+  return moves;
+}
+
+namespace {
+
+// heat map colors (256-color backgrounds) by how much worse than the best move, in centipawns:
+const char *heat_color(int loss) {
+  if (loss <= 20) return "\033[48;5;28m";    // green
+  if (loss <= 100) return "\033[48;5;106m";  // olive
+  if (loss <= 300) return "\033[48;5;178m";  // yellow
+  if (loss <= 800) return "\033[48;5;166m";  // orange
+  return "\033[48;5;124m";                   // red
+}
+
+std::string square_name(int square) { return {char('a' + square % 8), char('8' - square / 8)}; }
+
+}  // namespace
+
+void Game::print_moves(const std::string &input, const bool char_view, std::shared_ptr<const OpeningBook> book,
+                       const HeatMap &heat) {
   const std::string cols = "    a  b  c  d  e  f  g  h   ";
 
   char piece_char = input[0];
-  Field from(8 - (input[2] - '0'), input[1] - 'a');
+  Field from = input.size() >= 3 ? Field(8 - (input[2] - '0'), input[1] - 'a') : Field();
+  bool on_board = from.row >= 0 && from.row < 8 && from.col >= 0 && from.col < 8;
+  uint64_t position = hash();  // for book lookups
+
+  // all destinations are worked out before drawing, not square by square (none for a malformed input):
+  auto piece = on_board ? state_[from.row][from.col] : nullptr;
+  Bitboard to = piece && piece->to_char() == piece_char ? targets(from) : 0;
 
-  std::cout << CLEAR_SCREEN;
+  int best = heat.empty() ? 0 : heat.begin()->second;
+  for (const auto &entry : heat) best = std::max(best, entry.second);
+
+  clear_screen();
   std::cout << GREEN << cols << RESET << '\n';
   for (size_t i = 0; i < 8; ++i) {
     std::cout << GREEN << " " << 8 - i << RESET << ' ';
@@ -298,11 +806,16 @@ void Game::print_moves(const std::string &input, const bool char_view) {
     for (size_t j = 0; j < 8; ++j) {
       const auto &ptr = state_[i][j];
       bool occupied = ptr ? true : false;
-      Field to(i, j);
-      auto move = std::make_shared<Move>(piece_char, from, to, occupied);
-      bool valid = try_move(move);
-
-      if (valid)
+      bool valid = (to & square_bit(Field(i, j))) != 0;
+      auto move = std::make_shared<Move>(piece_char, from, Field(i, j), occupied);
+
+      // book moves are highlighted separately from the other valid moves:
+      auto scored = heat.find(i * 8 + j);
+      if (valid && scored != heat.end())
+        std::cout << heat_color(best - scored->second);
+      else if (valid && book && book->contains(position, move->pack()))
+        std::cout << GREEN_BG;
+      else if (valid)
         std::cout << YELLOW_BG;
       else
         std::cout << ((i + j) % 2 == 0 ? CYAN_BG : PINK_BG);
@@ -317,10 +830,21 @@ void Game::print_moves(const std::string &input, const bool char_view) {
     std::cout << RESET << ' ' << GREEN << 8 - i << '\n';
   }
   std::cout << GREEN << cols << RESET << '\n';
-  std::cout << (in_check(to_move()) ? "CHECK! " : "") << (to_move() == Player::White ? "White" : "Black")
-            << "'s turn.\n"
-            << "Commands: (:n)ew game (:u)ndo (:q)uit (:m)oves (:t)oggle character mode\n"
-            << "\033[43m" << "Input>" << RESET_BG;
+
+  // scores in pawns, best first:
+  if (!heat.empty()) {
+    std::vector<std::pair<int, int>> ranked(heat.begin(), heat.end());
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    std::cout << "Scores:";
+    for (const auto &entry : ranked) {
+      char pawns[16];
+      std::snprintf(pawns, sizeof(pawns), "%+.2f", entry.second / 100.0);
+      std::cout << ' ' << square_name(entry.first) << ' ' << pawns;
+    }
+    std::cout << '\n';
+  }
+  print_status();
 }
 
 // Beirut-mode specifics
@@ -329,17 +853,22 @@ bool Game::beirut_mode() const { return beirut_mode_; }
 
 void Game::enable_beirut_mode() { beirut_mode_ = true; }
 
-void Game::get_bomber(Player p, bool char_view) const {
+void Game::get_bomber(Player p, bool char_view, std::function<bool(std::string &)> read_line) {
+  if (!read_line) read_line = [](std::string &line) { return static_cast<bool>(std::getline(std::cin, line)); };
+
   // collect player inputs & give bombs to the pieces
   print_board(char_view);
 
-  std::regex valid_regex(p == Player::White ? "^[BNPQR][a-h][1-2]$" : "^[bnpqr][a-h][7-8]$");  // no king allowed
+  // own piece other than the king, on one of the player's first two rows:
+  const std::string pieces = p == Player::White ? "BNPQR" : "bnpqr";
+  const std::string rows = p == Player::White ? "12" : "78";
   std::string input;
 
   std::cout << (p == Player::White ? "White" : "Black") << "'s suicide bomber:>";
 
-  while (std::getline(std::cin, input)) {
-    if (!std::regex_match(input, valid_regex)) {
+  while (read_line(input)) {
+    if (input.size() != 3 || pieces.find(input[0]) == std::string::npos || input[1] < 'a' || input[1] > 'h' ||
+        rows.find(input[2]) == std::string::npos) {
       std::cout << "Invalid format; enter a piece belonging to you followed by "
                    "a field.\n>";
       continue;
@@ -362,56 +891,67 @@ void Game::get_bomber(Player p, bool char_view) const {
       continue;
     }
 
-    ptr->give_bomb();
+    give_bomb(p, location);
     break;
   }
 }
 
-bool Game::boom(Player p) {
-  // try to find player's bomb carrier:
-  bool found = false;
-  int brow, bcol;
+bool Game::give_bomb(Player p, Field location) {
+  // same rules as for the interactive choice: own piece in the first two rows, no king
+  int first_row = (p == Player::White) ? 6 : 0;
+  if (location.row < first_row || location.row > first_row + 1) return false;
+
+  auto ptr = state_[location.row][location.col];
+  if (!ptr || ptr->owner() != p || std::tolower(ptr->to_char()) == 'k') return false;
+
+  // pieces are shared prototypes, the carrier becomes a piece of its own:
+  state_[location.row][location.col] = PieceFactory::make_bomb_carrier(ptr->to_char());
+  return true;
+}
+
+bool Game::place_bomb(Field location) {
+  auto ptr = state_[location.row][location.col];
+  if (!ptr || std::tolower(ptr->to_char()) == 'k') return false;
+
+  state_[location.row][location.col] = PieceFactory::make_bomb_carrier(ptr->to_char());
+  return true;
+}
 
+std::shared_ptr<Move> Game::bomb_move(Player p) const {
+  // find player's bomb carrier:
   for (int i = 0; i < 8; ++i) {
     for (int j = 0; j < 8; ++j) {
       auto ptr = state_[i][j];
 
-      if (!ptr) continue;
-
-      if (ptr->carries_bomb() && ptr->owner() == p) {
-        found = true;
-        brow = i;
-        bcol = j;
-        break;
-      }
+      if (ptr && ptr->carries_bomb() && ptr->owner() == p) return std::make_shared<Move>(ptr->to_char(), Field(i, j));
     }
   }
 
+  return nullptr;
+}
+
+bool Game::boom(Player p) {
+  auto detonation = bomb_move(p);
+
   // if not found, print message to stdout and exit function.
-  if (!found) {
+  if (!detonation) {
     std::cout << "No bomb carrier for player " << (p == Player::White ? "white" : "black") << '\n';
-    return found;
+    return false;
   }
 
-  history_.push(state_);
-
   // "detonate bomb"; delete 3x3 window around carrier:
-  for (int i = std::max(0, brow - 1); i <= std::min(7, brow + 1); ++i) {
-    for (int j = std::max(0, bcol - 1); j <= std::min(7, bcol + 1); ++j) {
-      state_[i][j] = nullptr;
-    }
-  }
+  make_move(detonation);
 
   // trigger explosion effect:
-  explosion_effect(brow, bcol);
-  return found;
+  explosion_effect(detonation->from().row, detonation->from().col);
+  return true;
 };
 
 // basically print_board with different colors:
 void Game::explosion_effect(int r, int c, bool char_view) const {
   const std::string cols = "    a  b  c  d  e  f  g  h   ";
 
-  std::cout << CLEAR_SCREEN;
+  clear_screen();
   std::cout << GREEN << cols << RESET << '\n';
   for (int i = 0; i < 8; ++i) {
     std::cout << GREEN << " " << 8 - i << RESET << ' ';
@@ -437,6 +977,6 @@ void Game::explosion_effect(int r, int c, bool char_view) const {
   }
 
   // show for half a second then delegate back & show normal board again:
-  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  if (!script_mode) std::this_thread::sleep_for(std::chrono::milliseconds(500));
   print_board();
 };
\ No newline at end of file
@@ -0,0 +1,53 @@
+//===----------------------------------------------------------------------===//
+//
+// Thin RAII wrapper around POSIX `mmap` for the on-disk lookup tables
+// (opening book, position index), which are binary-searched in place.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);  // the mapping stays valid after closing the descriptor
+
+  if (mapping == MAP_FAILED) return false;
+
+  data_ = static_cast<const char *>(mapping);
+  size_ = info.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_) munmap(const_cast<char *>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool MappedFile::is_open() const { return data_ != nullptr; }
+
+const char *MappedFile::data() const { return data_; }
+
+std::size_t MappedFile::size() const { return size_; }
@@ -9,10 +9,14 @@
 
 #include "move.h"
 
+#include <cctype>
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "basics.h"
+#include "pieces.h"
+#include "stats.h"
 
 // Move
 
@@ -23,11 +27,36 @@ Move::Move(const std::string &input)
       from_(8 - (input[2] - '0'), input[1] - 'a'),
       to_(captures_ ? 8 - (input[5] - '0') : 8 - (input[4] - '0'), captures_ ? input[4] - 'a' : input[3] - 'a'),
       promotion_(input.size() > 6 && input[input.size() - 2] == '='),
-      promote_to_(promotion_ ? input[input.size() - 1] : '\0') {}
+      promote_to_(promotion_ ? input[input.size() - 1] : '\0'),
+      detonation_(false) {}
 
 // alternativ: moves zum ausprobieren aus Spielzustand generieren:
 Move::Move(char piece_char, Field from, Field to, bool captures)
-    : piece_char_(piece_char), captures_(captures), from_(from), to_(to), promotion_(false), promote_to_('\0') {}
+    : piece_char_(piece_char),
+      captures_(captures),
+      from_(from),
+      to_(to),
+      promotion_(false),
+      promote_to_('\0'),
+      detonation_(false) {}
+
+Move::Move(char piece_char, Field from, Field to, bool captures, char promote_to)
+    : piece_char_(piece_char),
+      captures_(captures),
+      from_(from),
+      to_(to),
+      promotion_(promote_to != '\0'),
+      promote_to_(promote_to),
+      detonation_(false) {}
+
+Move::Move(char piece_char, Field carrier)
+    : piece_char_(piece_char),
+      captures_(false),
+      from_(carrier),
+      to_(carrier),
+      promotion_(false),
+      promote_to_('\0'),
+      detonation_(true) {}
 
 char Move::piece_char() const { return piece_char_; }
 
@@ -37,10 +66,25 @@ bool Move::is_promotion() const { return promotion_; }
 
 char Move::promote_to() const { return promote_to_; }
 
+bool Move::is_detonation() const { return detonation_; }
+
 Field Move::from() const { return from_; }
 
 Field Move::to() const { return to_; }
 
+std::string Move::to_string() const {
+  if (detonation_) return "boom";
+
+  std::string result(1, piece_char_);
+  result += static_cast<char>('a' + from_.col);
+  result += static_cast<char>('0' + 8 - from_.row);
+  if (captures_) result += 'x';
+  result += static_cast<char>('a' + to_.col);
+  result += static_cast<char>('0' + 8 - to_.row);
+  if (promotion_) result += std::string("=") + promote_to_;
+  return result;
+}
+
 bool Move::unobstructed(const Board &board) const {
   int o_row = from_.row;
   int o_col = from_.col;
@@ -62,10 +106,92 @@ bool Move::unobstructed(const Board &board) const {
   return true;  // no obstructions found
 }
 
+/* Packed layout: bits 0-5 origin square, bits 6-11 destination square
+   (row * 8 + col each), bits 12-14 promotion piece (index into
+   `kPromotionPieces`, 0 = none), bit 15 set for detonations. The promoted
+   piece's color follows the moving pawn, so it does not need to be stored. */
+namespace {
+constexpr const char *kPromotionPieces = " nbrqp";
+}
+
+uint16_t Move::pack() const {
+  uint16_t promotion = 0;
+
+  if (promotion_) {
+    for (uint16_t i = 1; kPromotionPieces[i]; ++i)
+      if (kPromotionPieces[i] == std::tolower(promote_to_)) promotion = i;
+  }
+
+  return static_cast<uint16_t>((from_.row * 8 + from_.col) | ((to_.row * 8 + to_.col) << 6) | (promotion << 12) |
+                               (detonation_ << 15));
+}
+
 // Move factory
 
-MoveFactory::MoveFactory() : move_format_("^[BKNPQRbknpqr][a-h][1-8]x?[a-h][1-8](=[BKNPQRbknpqr])?$") {}
+namespace {
+
+// what each character can stand for in a move, computed at compile time:
+enum CharClass : uint8_t { kPiece = 1, kFile = 2, kRank = 4 };
+
+struct CharTable {
+  uint8_t classes[256] = {};
+
+  constexpr CharTable() {
+    for (char c : {'B', 'K', 'N', 'P', 'Q', 'R', 'b', 'k', 'n', 'p', 'q', 'r'}) classes[uint8_t(c)] |= kPiece;
+    for (char c = 'a'; c <= 'h'; ++c) classes[uint8_t(c)] |= kFile;
+    for (char c = '1'; c <= '8'; ++c) classes[uint8_t(c)] |= kRank;
+  }
+
+  constexpr bool is(char c, CharClass cls) const { return classes[uint8_t(c)] & cls; }
+};
+
+constexpr CharTable kChars;
 
-bool MoveFactory::valid(const std::string &input) const { return std::regex_match(input, move_format_); }
+}  // namespace
+
+bool MoveFactory::valid(const std::string &input) const {
+  STATS_SCOPE(Counter::MoveFormat);
+  if (input.size() < 5) return false;
+
+  size_t to = input[3] == 'x' ? 4 : 3;
+  size_t end = to + 2;  // after the destination
+  if (input.size() < end) return false;
+
+  if (!kChars.is(input[0], kPiece) || !kChars.is(input[1], kFile) || !kChars.is(input[2], kRank) ||
+      !kChars.is(input[to], kFile) || !kChars.is(input[to + 1], kRank))
+    return false;
+
+  // optional promotion:
+  return input.size() == end || (input.size() == end + 2 && input[end] == '=' && kChars.is(input[end + 1], kPiece));
+}
+
+std::shared_ptr<Move> MoveFactory::parse_move(const std::string &input) const {
+  STATS_SCOPE(Counter::ParseMove);
+  return std::make_shared<Move>(input);
+}
+
+std::shared_ptr<Move> MoveFactory::unpack(uint16_t packed, const Board &board) const {
+  Field from((packed & 0x3F) / 8, (packed & 0x3F) % 8);
+  Field to(((packed >> 6) & 0x3F) / 8, ((packed >> 6) & 0x3F) % 8);
+
+  const auto &piece = board[from.row][from.col];
+  if (!piece) return nullptr;  // packed move does not fit the board
+
+  return unpack(packed, piece->to_char(), board[to.row][to.col] != nullptr);
+}
+
+std::shared_ptr<Move> MoveFactory::unpack(uint16_t packed, char piece, bool captures) const {
+  Field from((packed & 0x3F) / 8, (packed & 0x3F) % 8);
+  Field to(((packed >> 6) & 0x3F) / 8, ((packed >> 6) & 0x3F) % 8);
+  int promotion = (packed >> 12) & 0x7;
+
+  if (packed >> 15) return std::make_shared<Move>(piece, from);
+
+  char promote_to = '\0';
+  if (promotion) {
+    promote_to = kPromotionPieces[promotion];
+    if (std::isupper(piece)) promote_to = std::toupper(promote_to);
+  }
 
-std::shared_ptr<Move> MoveFactory::parse_move(const std::string &input) const { return std::make_shared<Move>(input); }
\ No newline at end of file
+  return std::make_shared<Move>(piece, from, to, captures, promote_to);
+}
\ No newline at end of file
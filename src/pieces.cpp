@@ -10,23 +10,18 @@
 
 #include "pieces.h"
 
-#include <codecvt>
-#include <locale>
+#include <cctype>
 #include <memory>
 
 #include "basics.h"
 #include "move.h"
-
-Piece::Piece(Player p, char c) : player_(p), carries_bomb_(false) {
-  rep_ = (player_ == Player::White) ? std::toupper(c) : std::tolower(c);
-  unicode_ = 0;
-}
+#include "movegen.h"
 
 char Piece::to_char() const { return rep_; }
 
 std::string Piece::unicode() const {
-  std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> conv;
-  return conv.to_bytes(unicode_);
+  // UTF-8 by hand, all chess symbols take three bytes (U+2654 to U+265F):
+  return {char(0xE0 | (unicode_ >> 12)), char(0x80 | ((unicode_ >> 6) & 0x3F)), char(0x80 | (unicode_ & 0x3F))};
 }
 
 Player Piece::owner() const { return player_; }
@@ -35,109 +30,93 @@ bool Piece::carries_bomb() const { return carries_bomb_; }
 
 void Piece::give_bomb() { carries_bomb_ = true; }
 
-Bishop::Bishop(Player p) : Piece(p, 'B') { unicode_ = 0x265D; }
-
-bool Bishop::valid(std::shared_ptr<Move> move, const Board &board) const {
-  Field from = move->from();
-  Field to = move->to();
-
-  int dx = std::abs(to.col - from.col);
-  int dy = std::abs(to.row - from.row);
+// the rules themselves are in movegen.h, shared with `Game::substantively_valid` (the side only matters for pawns):
 
-  return (dx == dy) && move->unobstructed(board);  // diagonal move (same vertical and horizontal diff)
+bool Bishop::valid(const Move &move, const Board &board) const {
+  return reaches<Player::White, PieceKind::Bishop>(move, board);
 }
 
-King::King(Player p) : Piece(p, 'K') { unicode_ = 0x265A; }
-
-bool King::valid(std::shared_ptr<Move> move, const Board &board) const {
-  (void)board;  // unused
-
-  Field from = move->from();
-  Field to = move->to();
-
-  return (std::abs(to.col - from.col) <= 1 && std::abs(to.row - from.row) <= 1);
+bool King::valid(const Move &move, const Board &board) const {
+  return reaches<Player::White, PieceKind::King>(move, board);
 }
 
-Knight::Knight(Player p) : Piece(p, 'N') { unicode_ = 0x265E; }
-
-bool Knight::valid(std::shared_ptr<Move> move, const Board &board) const {
-  (void)board;  // unused
-
-  Field from = move->from();
-  Field to = move->to();
-
-  int dx = std::abs(to.col - from.col);
-  int dy = std::abs(to.row - from.row);
-
-  return (dx == 2 && dy == 1) || (dx == 1 && dy == 2);
+bool Knight::valid(const Move &move, const Board &board) const {
+  return reaches<Player::White, PieceKind::Knight>(move, board);
 }
 
-Pawn::Pawn(Player p) : Piece(p, 'P') { unicode_ = 0x265F; }
-
-bool Pawn::valid(std::shared_ptr<Move> move, const Board &board) const {
-  int direction = (owner() == Player::White) ? -1 : 1;
-
-  Field from = move->from();
-  Field to = move->to();
-
-  int dx = to.col - from.col;
-  int dy = to.row - from.row;
-
-  // single move forward:
-  if (dx == 0 && dy == direction && !board[to.row][to.col]) return true;
-
-  // double move forward (only from starting position):
-  int start_row = (owner() == Player::White) ? 6 : 1;
-  if (dx == 0 && dy == 2 * direction && from.row == start_row && !board[to.row][to.col] && move->unobstructed(board))
-    return true;
-
-  // capture (diagonally):
-  if (std::abs(dx) == 1 && dy == direction && move->has_capture() && board[to.row][to.col]) return true;
-
-  return false;
+template <Player P>
+bool Pawn<P>::valid(const Move &move, const Board &board) const {
+  return reaches<P, PieceKind::Pawn>(move, board);
 }
 
-Queen::Queen(Player p) : Piece(p, 'Q') { unicode_ = 0x265B; }
-
-bool Queen::valid(std::shared_ptr<Move> move, const Board &board) const {
-  Field from = move->from();
-  Field to = move->to();
-
-  int dx = std::abs(to.col - from.col);
-  int dy = std::abs(to.row - from.row);
+template class Pawn<Player::White>;
+template class Pawn<Player::Black>;
 
-  return ((dx == dy) || (dx == 0 || dy == 0)) && move->unobstructed(board);
+bool Queen::valid(const Move &move, const Board &board) const {
+  return reaches<Player::White, PieceKind::Queen>(move, board);
 }
 
-Rook::Rook(Player p) : Piece(p, 'R') { unicode_ = 0x265C; }
-
-bool Rook::valid(std::shared_ptr<Move> move, const Board &board) const {
-  Field from = move->from();
-  Field to = move->to();
+bool Rook::valid(const Move &move, const Board &board) const {
+  return reaches<Player::White, PieceKind::Rook>(move, board);
+}
 
-  int dx = std::abs(to.col - from.col);
-  int dy = std::abs(to.row - from.row);
+// Factories
 
-  return (dx == 0 || dy == 0) && move->unobstructed(board);
+namespace {
+
+// constant-initialized, they exist before `main` without running any code:
+Bishop white_bishop(Player::White), black_bishop(Player::Black);
+King white_king(Player::White), black_king(Player::Black);
+Knight white_knight(Player::White), black_knight(Player::Black);
+Pawn<Player::White> white_pawn;
+Pawn<Player::Black> black_pawn;
+Queen white_queen(Player::White), black_queen(Player::Black);
+Rook white_rook(Player::White), black_rook(Player::Black);
+
+Piece *prototype(char c) {
+  switch (c) {
+    case 'B': return &white_bishop;
+    case 'b': return &black_bishop;
+    case 'K': return &white_king;
+    case 'k': return &black_king;
+    case 'N': return &white_knight;
+    case 'n': return &black_knight;
+    case 'P': return &white_pawn;
+    case 'p': return &black_pawn;
+    case 'Q': return &white_queen;
+    case 'q': return &black_queen;
+    case 'R': return &white_rook;
+    case 'r': return &black_rook;
+  }
+  return nullptr;
 }
 
-// Factories
+}  // namespace
 
-PieceFactory::PieceFactory() {
-  pieces_ = {
-      {'b', [](Player p) { return std::make_shared<Bishop>(p); }},
-      {'k', [](Player p) { return std::make_shared<King>(p); }},
-      {'q', [](Player p) { return std::make_shared<Queen>(p); }},
-      {'r', [](Player p) { return std::make_shared<Rook>(p); }},
-      {'n', [](Player p) { return std::make_shared<Knight>(p); }},
-      {'p', [](Player p) { return std::make_shared<Pawn>(p); }},
-  };
+std::shared_ptr<Piece> PieceFactory::make_piece(char c) {
+  // aliasing an empty owner: no control block, the prototypes live as long as the program
+  return std::shared_ptr<Piece>(std::shared_ptr<Piece>(), prototype(c));
 }
 
-std::shared_ptr<Piece> PieceFactory::make_piece(char c) const {
+std::shared_ptr<Piece> PieceFactory::make_bomb_carrier(char c) {
   Player player = std::isupper(c) ? Player::White : Player::Black;
-  char lower = std::tolower(c);
-
-  auto match = pieces_.find(lower);
-  return match->second(player);
-}
\ No newline at end of file
+  std::shared_ptr<Piece> piece;
+
+  switch (std::tolower(c)) {
+    case 'b': piece = std::make_shared<Bishop>(player); break;
+    case 'k': piece = std::make_shared<King>(player); break;
+    case 'n': piece = std::make_shared<Knight>(player); break;
+    case 'p':
+      if (player == Player::White)
+        piece = std::make_shared<Pawn<Player::White>>();
+      else
+        piece = std::make_shared<Pawn<Player::Black>>();
+      break;
+    case 'q': piece = std::make_shared<Queen>(player); break;
+    case 'r': piece = std::make_shared<Rook>(player); break;
+    default: return nullptr;
+  }
+
+  piece->give_bomb();
+  return piece;
+}
@@ -0,0 +1,439 @@
+//===----------------------------------------------------------------------===//
+//
+// The actual game loop. It is layed out in `play` and reacts to events:
+// lines of input (read from `std::cin` on a background thread, see
+// `read_input`) and, when playing against the engine, the engine's moves.
+// Basically, we first check whether an input matches a known command. If
+// not, we try to validate & parse it as move. If not, we keep trying to get
+// a valid/recognized input from the player. After a valid move has been
+// made, it's the other player's turn.
+//
+// The engine searches on its own thread, so commands like :q or :s are
+// still answered while it thinks. Moves typed meanwhile (piped input sends
+// all of them at once) wait for its reply, and so does every line after
+// them, to keep their order. With pondering the engine also keeps searching
+// during the player's turn (see `Engine::ponder`).
+//
+// With a session log every event is recorded in the order it is handled,
+// so tools/replay.cpp can feed them back in & get the same game.
+//
+//===----------------------------------------------------------------------===//
+
+#include "play.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "stats.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+uint32_t latency_us(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count();
+}
+
+// logs a line of input once the game loop is done with it (at any `continue` or `break`), then the
+// bombers picked while handling it
+class LineRecord {
+  std::shared_ptr<SessionLog> log_;
+  std::string line_;
+  const std::shared_ptr<Game> &game_;  // :n replaces the game
+  std::vector<std::string> &bombers_;
+  Clock::time_point start_ = Clock::now();
+
+ public:
+  LineRecord(std::shared_ptr<SessionLog> log, const std::string &line, const std::shared_ptr<Game> &game,
+             std::vector<std::string> &bombers)
+      : log_(log), line_(line), game_(game), bombers_(bombers) {}
+
+  ~LineRecord() {
+    if (!log_) return;
+    log_->record(LogKind::Line, line_, game_->hash(), latency_us(start_));
+    for (const auto &bomber : bombers_) log_->record(LogKind::Bomber, bomber, game_->hash());
+    bombers_.clear();
+  }
+};
+
+}  // namespace
+
+bool parse_options(const std::vector<std::string> &args, PlayOptions &options) {
+  EngineConfig engine_config;
+  EngineConfig analysis_config;
+  EngineConfig::parse("depth=3,movetime=300", analysis_config);
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string &arg = args[i];
+    bool has_value = i + 1 < args.size();
+
+    if (arg == "beirut") options.beirut = true;
+
+    // scripted input (e.g. graders piping moves in): no screen clearing & no animations
+    if (arg == "--script") Game::set_script_mode(true);
+
+    // optional opening book, book moves are highlighted in the :m preview
+    if (arg == "--book" && has_value && !options.book->open(args[++i]))
+      std::cerr << "Could not open opening book " << args[i] << ", continuing without\n";
+
+    // play against the engine ("depth=N", see `EngineConfig`), black unless --engine-white
+    if (arg == "--engine" && has_value) {
+      const std::string &spec = args[++i];
+      if (!EngineConfig::parse(spec, engine_config)) {
+        std::cerr << "Invalid engine " << spec << '\n';
+        return false;
+      }
+      options.opponent.engine = std::make_shared<Engine>(engine_config, std::random_device()());
+    }
+    if (arg == "--engine-white") options.opponent.side = Player::White;
+    if (arg == "--ponder") options.opponent.ponder = true;  // engine thinks during the player's turn
+
+    // scores shown in the :m preview ("off" for none)
+    if (arg == "--analysis" && has_value) {
+      const std::string &spec = args[++i];
+      if (spec == "off") {
+        analysis_config.depth = 0;
+      } else if (!EngineConfig::parse(spec, analysis_config)) {
+        std::cerr << "Invalid analysis " << spec << '\n';
+        return false;
+      }
+    }
+
+    // clocks, e.g. "5+3" for 5 minutes per side & 3 seconds more per move
+    if (arg == "--time" && has_value && !TimeControl::parse(args[++i], options.time_control)) {
+      std::cerr << "Invalid time control " << args[i] << '\n';
+      return false;
+    }
+
+    // optional directory of endgame tablebases (`*.tb` files written by bin/tbgen)
+    if (arg == "--tb" && has_value && options.tablebases->load_directory(args[++i]) == 0)
+      std::cerr << "No tablebases found in " << args[i] << ", continuing without\n";
+
+    // session log for tools/replay.cpp, appended to
+    if (arg == "--log" && has_value) {
+      options.log = std::make_shared<SessionLog>(args[++i]);
+      if (!options.log->ok()) {
+        std::cerr << "Could not open session log " << args[i] << '\n';
+        return false;
+      }
+    }
+  }
+
+  if (options.opponent.engine) options.opponent.engine->set_book(options.book);
+  options.analyst = analysis_config.depth ? std::make_shared<Engine>(analysis_config) : nullptr;
+
+  if (options.log) {
+    std::string start;
+    for (const auto &arg : args) start += arg + '\0';
+    options.log->record(LogKind::Start, start, 0);
+  }
+  return true;
+}
+
+void show_prompt() { std::cout << "\033[43m" << "Input>" << "\033[49m"; }
+
+HeatMap heat_map(Game &game, const std::string &input, std::shared_ptr<Engine> analyst) {
+  HeatMap heat;
+  if (!analyst || input.size() < 3 || input[1] < 'a' || input[1] > 'h' || input[2] < '1' || input[2] > '8') return heat;
+
+  Field from(8 - (input[2] - '0'), input[1] - 'a');
+  auto piece = game.board()[from.row][from.col];
+  if (!piece || piece->to_char() != input[0]) return heat;
+
+  for (const auto &entry : analyst->analyze(game, from)) {
+    int square = entry.move->to().row * 8 + entry.move->to().col;
+    int score = std::max(-9999, std::min(9999, entry.score));  // mates show as +-99.99
+    auto known = heat.find(square);
+    if (known == heat.end() || known->second < score) heat[square] = score;  // best of the promotions
+  }
+  return heat;
+}
+
+void play(std::shared_ptr<EventQueue> events, PlayOptions options) {
+  bool beirut = options.beirut;
+  bool char_mode = options.char_mode;
+  auto book = options.book;
+  auto analyst = options.analyst;
+  auto log = options.log;
+  Opponent opponent = options.opponent;
+  auto engine = opponent.engine;
+  MoveFactory movemaker;  // validates move inputs
+
+  std::deque<Event> typed_ahead;  // lines (& the end of input) that came in while the engine was to move
+
+  std::vector<std::string> bombers;  // picked while handling a line, logged after it (see `LineRecord`)
+  auto read_line = [events, log, &bombers, &typed_ahead](std::string &line) {
+    if (!typed_ahead.empty()) {
+      Event event = typed_ahead.front();
+      typed_ahead.pop_front();
+      if (event.kind == Event::Kind::EndOfInput) return false;
+      line = event.line;
+    } else if (!events->wait_line(line)) {
+      return false;
+    }
+    if (log) bombers.push_back(line);
+    return true;
+  };
+
+  auto game = std::make_shared<Game>();
+  game->set_tablebases(options.tablebases);
+
+  if (beirut) {
+    game->enable_beirut_mode();
+    game->get_bomber(Player::White, char_mode, read_line);
+    game->get_bomber(Player::Black, char_mode, read_line);
+    if (log) {
+      for (const auto &bomber : bombers) log->record(LogKind::Bomber, bomber, game->hash());
+      bombers.clear();
+    }
+  }
+
+  if (options.time_control.base_ms) game->set_time_control(options.time_control);  // after picking the bombers
+
+  game->show(char_mode);  // show initial state
+
+  auto engine_to_move = [&] { return (engine || opponent.scripted) && game->to_move() == opponent.side; };
+
+  // the engine searches a copy of the game on its own thread & reports back with an event:
+  std::thread thinking;
+  auto cancel = std::make_shared<std::atomic<bool>>(false);
+  uint64_t search = 0;  // id of the latest search, the moves of searches cancelled since are dropped
+  Clock::time_point think_start;
+  auto think = [&] {
+    if (!engine_to_move() || thinking.joinable()) return;
+
+    think_start = Clock::now();
+    if (opponent.scripted) return;  // the move is queued already
+
+    Game position = *game;
+    cancel = std::make_shared<std::atomic<bool>>(false);  // one per search
+    thinking = std::thread([engine, events, position, cancel, id = ++search]() mutable {
+      uint64_t hash = position.hash();
+      events->push({Event::Kind::EngineMove, "", engine->best_move(position, cancel.get()), hash, id});
+    });
+  };
+  auto stop_thinking = [&] {
+    if (!thinking.joinable()) return;
+    *cancel = true;
+    thinking.join();
+    ++search;  // whatever it found is stale, even if still queued
+  };
+
+  think();
+  bool input_closed = false;
+
+  for (;;) {
+    Event event;
+    if (!typed_ahead.empty() && !engine_to_move()) {
+      event = typed_ahead.front();
+      typed_ahead.pop_front();
+    } else {
+      event = events->wait();
+    }
+
+    // moves wait for the engine's reply, commands (starting with ':') are answered at once if nothing waits:
+    bool is_move = event.kind == Event::Kind::Line && event.line.rfind(":", 0) != 0;
+    if (event.kind != Event::Kind::EngineMove && engine_to_move() && (is_move || !typed_ahead.empty())) {
+      typed_ahead.push_back(event);
+      continue;
+    }
+
+    // end of (scripted) input: the engine still gets to reply to the last move
+    if (event.kind == Event::Kind::EndOfInput) {
+      if (!thinking.joinable()) break;
+      input_closed = true;
+      continue;
+    }
+
+    if (event.kind == Event::Kind::EngineMove) {
+      // a cancelled search still reports a move, possibly for the same position (:n at the start, :c):
+      if (!opponent.scripted && event.search != search) {
+        if (input_closed && !thinking.joinable()) break;
+        continue;
+      }
+
+      if (thinking.joinable()) thinking.join();
+      if (!engine_to_move() || event.position != game->hash()) {
+        if (input_closed) break;
+        continue;  // position changed meanwhile (:u, :n)
+      }
+
+      if (!event.move) {
+        if (log) log->record(LogKind::EngineMove, "", game->hash(), latency_us(think_start));
+        std::cout << "No valid moves left, draw\n";
+        break;
+      }
+
+      game->make_move(event.move);
+      game->swap();
+      game->punch_clock();
+      if (log) {
+        std::string data = SessionLog::encode_move(*event.move, event.position);
+        log->record(LogKind::EngineMove, data, game->hash(), latency_us(think_start));
+      }
+
+      if (game->flagged(opponent.side)) {
+        std::cout << "The engine lost on time, game over\n";
+        break;
+      }
+
+      if (game->checkmate(game->to_move())) {
+        std::cout << "Checkmate, game over\n";
+        break;
+      }
+
+      std::cout << "Engine played " << event.move->to_string() << '\n';
+      game->show(char_mode);
+      if (input_closed) break;
+      if (opponent.ponder) engine->ponder(*game);
+      continue;
+    }
+
+    const std::string &input = event.line;
+    LineRecord record(log, input, game, bombers);
+
+    // First check if the input matches any command:
+
+    if (input == ":q") break;
+
+    if (input == ":n") {
+      stop_thinking();
+      auto tablebases = game->tablebases();
+      auto time_control = game->time_control();
+      game = std::make_shared<Game>();
+      game->set_tablebases(tablebases);
+      if (game->to_move() != Player::White) game->swap();
+
+      if (beirut) {
+        game->enable_beirut_mode();
+        game->get_bomber(Player::White, char_mode, read_line);
+        game->get_bomber(Player::Black, char_mode, read_line);
+      }
+      if (time_control.base_ms) game->set_time_control(time_control);
+      game->show(char_mode);
+      think();
+      continue;
+    }
+
+    if (input == ":u") {
+      stop_thinking();
+      game->jump_to(game->ply() - 1);
+      if (engine_to_move() && game->ply() > 0) game->jump_to(game->ply() - 1);  // the engine's move goes too
+      game->show(char_mode);
+      think();
+      continue;
+    }
+
+    if (input == ":t") {
+      char_mode = !char_mode;
+      game->show(char_mode);
+      continue;
+    }
+
+    if (input == ":s") {
+      Stats::local().set_memory(game->memory_usage());
+      Stats::local().report(std::cout);
+      show_prompt();
+      continue;
+    }
+
+    // time control, e.g. ":c 5+3" (minutes + increment in seconds), restarts both clocks:
+    if (input.rfind(":c", 0) == 0) {
+      TimeControl control;
+      size_t start = input.find_first_not_of(' ', 2);
+      if (start == std::string::npos || !TimeControl::parse(input.substr(start), control)) {
+        std::cout << "Time control like :c 5+3 (minutes + increment in seconds)\n";
+        show_prompt();
+        continue;
+      }
+
+      stop_thinking();
+      game->set_time_control(control);
+      game->show(char_mode);
+      think();
+      continue;
+    }
+
+    if (input.rfind(":m", 0) == 0 && input.length() > 2) {
+      std::string move_input = input.substr(2);
+      game->print_moves(move_input, char_mode, book, heat_map(*game, move_input, analyst));
+      continue;
+    }
+
+    // the flag fell before the move came in, it is not made:
+    if (game->flagged(game->to_move())) {
+      std::cout << "Out of time, game over\n";
+      break;
+    }
+
+    if (input == "boom") {
+      if (!beirut) {
+        show_prompt();
+        continue;
+      }
+
+      bool bomber_found = game->boom(game->to_move());
+
+      if (!bomber_found) {
+        show_prompt();
+        continue;
+      }
+
+      // player could accidentally checkmate themselves with bomb:
+      if (game->checkmate(game->to_move())) {
+        std::cout << "You blew up your own king you retard\n";
+        break;
+      }
+
+      game->swap();
+      game->punch_clock();
+
+      if (game->checkmate(game->to_move())) {
+        std::cout << "Checkmate, game over\n";
+        break;
+      }
+
+      game->show();
+      think();
+      continue;
+    }
+
+    // if not recognized as command we try to parse the input as move:
+
+    if (!movemaker.valid(input)) {
+      std::cout << "Invalid format!\n";
+      show_prompt();
+      continue;
+    }
+
+    auto move = movemaker.parse_move(input);
+
+    if (!game->try_move(move)) {
+      std::cout << "That move is not valid!\n";
+      show_prompt();
+      continue;
+    }
+
+    // All good, make move & swap players (next turn):
+
+    game->make_move(move);
+    game->swap();
+    game->punch_clock();
+
+    if (game->checkmate(game->to_move())) {
+      std::cout << "Checkmate, game over\n";
+      break;
+    };
+
+    game->show(char_mode);
+    think();
+  }
+
+  stop_thinking();
+  Stats::local().set_memory(game->memory_usage());  // for the exit dump
+}
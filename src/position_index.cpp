@@ -0,0 +1,300 @@
+//===----------------------------------------------------------------------===//
+//
+// Position index: which games of an archive reached a position. Games are
+// replayed through `Game` (so positions are real positions, not text), every
+// position becomes a (hash, game, ply) record, and the records are sorted in
+// memory-sized runs on disk & merged into the final index. The merge groups
+// equal hashes into one key, and equal (hash, game) pairs into one posting.
+//
+//===----------------------------------------------------------------------===//
+
+#include "position_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "move.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'H', 'P', 'I', 'D', 'X', '0', '1'};
+
+struct IndexHeader {
+  char magic[8];
+  uint64_t key_count;
+  uint64_t posting_count;
+  uint64_t reserved;
+};
+
+static_assert(sizeof(IndexHeader) % 8 == 0, "keys & postings stay 8-byte aligned");
+
+using Occurrence = PositionIndexBuilder::Occurrence;
+
+bool occurrence_order(const Occurrence &a, const Occurrence &b) {
+  return std::tie(a.hash, a.game, a.ply) < std::tie(b.hash, b.game, b.ply);
+}
+
+// sequential reader of one sorted run
+class RunReader {
+  std::ifstream in_;
+  Occurrence current_;
+  bool done_;
+
+ public:
+  explicit RunReader(const std::string &path) : in_(path, std::ios::binary), current_(), done_(false) { next(); }
+  const Occurrence &current() const { return current_; }
+  bool done() const { return done_; }
+
+  void next() {
+    if (!in_.read(reinterpret_cast<char *>(&current_), sizeof(current_))) done_ = true;
+  }
+};
+
+template <typename Record>
+void write_record(std::ofstream &out, const Record &record) {
+  out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+}
+
+const std::size_t kMaxFanIn = 16;  // runs merged at once (open files)
+
+// k-way merge of sorted runs, `emit` gets every record in order
+template <typename Emit>
+void merge_runs(const std::vector<std::string> &runs, Emit emit) {
+  std::vector<std::unique_ptr<RunReader>> readers;
+  for (const auto &run : runs) readers.push_back(std::make_unique<RunReader>(run));
+
+  // smallest record on top:
+  auto later = [&](size_t a, size_t b) { return occurrence_order(readers[b]->current(), readers[a]->current()); };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+  for (size_t i = 0; i < readers.size(); ++i)
+    if (!readers[i]->done()) heap.push(i);
+
+  while (!heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    emit(readers[i]->current());
+    readers[i]->next();
+    if (!readers[i]->done()) heap.push(i);
+  }
+}
+
+}  // namespace
+
+// Position index
+
+PositionIndex::PositionIndex() : keys_(nullptr), postings_(nullptr), key_count_(0), posting_count_(0) {}
+
+bool PositionIndex::open(const std::string &path) {
+  keys_ = nullptr;
+  postings_ = nullptr;
+  key_count_ = 0;
+  posting_count_ = 0;
+
+  if (!file_.open(path)) return false;
+
+  // each count is checked against the rest of the file before multiplying, crafted ones could overflow:
+  const auto *header = reinterpret_cast<const IndexHeader *>(file_.data());
+  bool valid = file_.size() >= sizeof(IndexHeader) && std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0;
+  std::size_t rest = valid ? file_.size() - sizeof(IndexHeader) : 0;
+  valid = valid && header->key_count <= rest / sizeof(IndexKey);
+  if (valid) rest -= header->key_count * sizeof(IndexKey);
+  valid = valid && header->posting_count <= rest / sizeof(IndexPosting) &&
+          rest == header->posting_count * sizeof(IndexPosting);
+  if (!valid) {
+    file_.close();
+    return false;
+  }
+
+  keys_ = reinterpret_cast<const IndexKey *>(file_.data() + sizeof(IndexHeader));
+  postings_ = reinterpret_cast<const IndexPosting *>(keys_ + header->key_count);
+  key_count_ = header->key_count;
+  posting_count_ = header->posting_count;
+  return true;
+}
+
+bool PositionIndex::is_open() const { return keys_ != nullptr; }
+
+std::size_t PositionIndex::size() const { return key_count_; }
+
+const IndexKey *PositionIndex::find_key(uint64_t hash) const {
+  if (!is_open()) return nullptr;
+
+  auto key = std::lower_bound(keys_, keys_ + key_count_, hash,
+                              [](const IndexKey &key, uint64_t h) { return key.hash < h; });
+  return key != keys_ + key_count_ && key->hash == hash ? key : nullptr;
+}
+
+std::vector<IndexPosting> PositionIndex::games(uint64_t hash) const {
+  const IndexKey *key = find_key(hash);
+  if (!key || key->first > posting_count_ || key->games > posting_count_ - key->first) return {};
+
+  return std::vector<IndexPosting>(postings_ + key->first, postings_ + key->first + key->games);
+}
+
+std::vector<IndexPosting> PositionIndex::games(const Game &game) const { return games(game.hash()); }
+
+uint32_t PositionIndex::occurrences(uint64_t hash) const {
+  const IndexKey *key = find_key(hash);
+  return key ? key->occurrences : 0;
+}
+
+// Index builder
+
+PositionIndexBuilder::PositionIndexBuilder(const std::string &path, std::size_t memory_budget)
+    : path_(path), run_capacity_(std::max<std::size_t>(1, memory_budget / sizeof(Occurrence))), run_count_(0),
+      games_(0), positions_(0), ok_(true) {}
+
+PositionIndexBuilder::~PositionIndexBuilder() {
+  for (const auto &run : runs_) std::remove(run.c_str());
+}
+
+bool PositionIndexBuilder::spill() {
+  if (buffer_.empty()) return true;
+
+  std::sort(buffer_.begin(), buffer_.end(), occurrence_order);
+
+  std::string run = path_ + ".run" + std::to_string(run_count_++);
+  std::ofstream out(run, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(buffer_.data()), buffer_.size() * sizeof(Occurrence));
+  runs_.push_back(run);
+  buffer_.clear();
+
+  if (!out) ok_ = false;
+  return static_cast<bool>(out);
+}
+
+bool PositionIndexBuilder::add_game(const std::string &moves, int max_plies) {
+  Game game;
+  MoveFactory movemaker;
+  std::istringstream stream(moves);
+  std::string input;
+  uint32_t id = games_++;
+
+  auto record = [&](uint32_t ply) {
+    if (buffer_.empty()) buffer_.reserve(run_capacity_);
+    buffer_.push_back({game.hash(), id, ply});
+    positions_++;
+    return buffer_.size() < run_capacity_ || spill();
+  };
+
+  if (!record(0)) return false;  // every game reaches the start position
+
+  for (int ply = 0; ply < max_plies && stream >> input; ++ply) {
+    if (!movemaker.valid(input)) return false;
+
+    auto move = movemaker.parse_move(input);
+    if (!game.try_move(move)) return false;
+
+    game.make_move(move);
+    game.swap();
+    if (!record(ply + 1)) return false;
+  }
+
+  return true;
+}
+
+bool PositionIndexBuilder::ok() const { return ok_; }
+
+uint32_t PositionIndexBuilder::games() const { return games_; }
+
+uint64_t PositionIndexBuilder::positions() const { return positions_; }
+
+std::size_t PositionIndexBuilder::runs() const { return run_count_; }
+
+bool PositionIndexBuilder::finish() {
+  if (!spill() || !ok_) return false;
+
+  // too many runs to open at once are merged into longer runs first:
+  while (runs_.size() > kMaxFanIn) {
+    std::vector<std::string> group(runs_.begin(), runs_.begin() + kMaxFanIn);
+    std::string merged = path_ + ".run" + std::to_string(run_count_++);
+    {
+      std::ofstream out(merged, std::ios::binary | std::ios::trunc);
+      merge_runs(group, [&](const Occurrence &occurrence) { write_record(out, occurrence); });
+      if (!out) {
+        std::remove(merged.c_str());
+        return false;
+      }
+    }
+
+    for (const auto &run : group) std::remove(run.c_str());
+    runs_.erase(runs_.begin(), runs_.begin() + kMaxFanIn);
+    runs_.push_back(merged);
+  }
+
+  // keys & postings are merged into separate files, then put behind the header:
+  std::string keys_path = path_ + ".keys", postings_path = path_ + ".postings";
+  std::ofstream keys(keys_path, std::ios::binary | std::ios::trunc);
+  std::ofstream postings(postings_path, std::ios::binary | std::ios::trunc);
+
+  uint64_t key_count = 0, posting_count = 0;
+  IndexKey key{};
+  IndexPosting posting{};
+  bool open_key = false;
+
+  auto flush_posting = [&] {
+    write_record(postings, posting);
+    posting_count++;
+    key.games++;
+  };
+  auto flush_key = [&] {
+    flush_posting();
+    write_record(keys, key);
+    key_count++;
+  };
+
+  merge_runs(runs_, [&](const Occurrence &occurrence) {
+    if (open_key && occurrence.hash == key.hash && occurrence.game == posting.game) {
+      posting.occurrences = static_cast<uint16_t>(std::min(posting.occurrences + 1, 0xFFFF));
+    } else {
+      if (open_key && occurrence.hash == key.hash) {
+        flush_posting();
+      } else {
+        if (open_key) flush_key();
+        key = IndexKey{occurrence.hash, posting_count, 0, 0};
+        open_key = true;
+      }
+      posting = IndexPosting{occurrence.game, static_cast<uint16_t>(std::min<uint32_t>(occurrence.ply, 0xFFFF)), 1};
+    }
+
+    if (key.occurrences != UINT32_MAX) key.occurrences++;
+  });
+  if (open_key) flush_key();
+
+  keys.close();
+  postings.close();
+  for (const auto &run : runs_) std::remove(run.c_str());
+  runs_.clear();
+
+  // a short write would leave the header's counts not matching the body:
+  if (!keys || !postings) {
+    std::remove(keys_path.c_str());
+    std::remove(postings_path.c_str());
+    return false;
+  }
+
+  IndexHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.key_count = key_count;
+  header.posting_count = posting_count;
+
+  std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+  write_record(out, header);
+  for (const auto &part : {keys_path, postings_path}) {
+    std::ifstream in(part, std::ios::binary);
+    if (in.peek() != std::ifstream::traits_type::eof()) out << in.rdbuf();
+    std::remove(part.c_str());
+  }
+
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,183 @@
+//===----------------------------------------------------------------------===//
+//
+// Reference move generator for differential testing. Kept as simple as the
+// rules allow on purpose: when `Game` & this disagree, the bug is almost
+// certainly in `Game`, which is the one that gets optimized.
+//
+//===----------------------------------------------------------------------===//
+
+#include "reference.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kKnight[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+const int kKing[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+const int kDiagonals[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+const int kLines[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+bool on_board(int row, int col) { return row >= 0 && row < 8 && col >= 0 && col < 8; }
+
+char at(const std::string &position, int row, int col) { return position[row * 8 + col]; }
+
+bool owned_by(char piece, Player p) {
+  return piece != ' ' && (p == Player::White ? std::isupper(piece) != 0 : std::islower(piece) != 0);
+}
+
+char piece_of(Player p, char kind) { return p == Player::White ? std::toupper(kind) : std::tolower(kind); }
+
+Player other(Player p) { return p == Player::White ? Player::Black : Player::White; }
+
+// is (row, col) attacked by a piece of `by`?
+bool attacked(const std::string &position, int row, int col, Player by) {
+  for (const auto &step : kKnight) {
+    int r = row + step[0], c = col + step[1];
+    if (on_board(r, c) && at(position, r, c) == piece_of(by, 'n')) return true;
+  }
+
+  for (const auto &step : kKing) {
+    int r = row + step[0], c = col + step[1];
+    if (on_board(r, c) && at(position, r, c) == piece_of(by, 'k')) return true;
+  }
+
+  // white pawns move up (towards row 0), so they attack from the row below:
+  int pawn_row = by == Player::White ? row + 1 : row - 1;
+  for (int c : {col - 1, col + 1})
+    if (on_board(pawn_row, c) && at(position, pawn_row, c) == piece_of(by, 'p')) return true;
+
+  for (int kind = 0; kind < 2; ++kind) {
+    const auto &rays = kind == 0 ? kDiagonals : kLines;
+    char slider = piece_of(by, kind == 0 ? 'b' : 'r');
+
+    for (const auto &ray : rays) {
+      for (int r = row + ray[0], c = col + ray[1]; on_board(r, c); r += ray[0], c += ray[1]) {
+        char piece = at(position, r, c);
+        if (piece == ' ') continue;
+        if (piece == slider || piece == piece_of(by, 'q')) return true;
+        break;
+      }
+    }
+  }
+
+  return false;
+}
+
+std::string square(int row, int col) { return {char('a' + col), char('0' + 8 - row)}; }
+
+}  // namespace
+
+bool reference_in_check(const std::string &position, Player p) {
+  size_t king = position.find(piece_of(p, 'k'));
+  if (king == std::string::npos) return false;
+
+  return attacked(position, king / 8, king % 8, other(p));
+}
+
+std::vector<std::string> reference_moves(const std::string &position, Player to_move) {
+  std::vector<std::string> moves;
+  if (position.find(piece_of(to_move, 'k')) == std::string::npos) return moves;  // no king, no moves
+
+  // keeps the move if it does not leave the own king in check:
+  auto add = [&](int row, int col, int r, int c) {
+    std::string after = position;
+    char piece = after[row * 8 + col];
+    bool captures = after[r * 8 + c] != ' ';
+    after[r * 8 + c] = piece;
+    after[row * 8 + col] = ' ';
+    if (reference_in_check(after, to_move)) return;  // promotions block like the pawn, one check covers them
+
+    std::string move = std::string(1, piece) + square(row, col) + (captures ? "x" : "") + square(r, c);
+    moves.push_back(move);
+
+    if (std::tolower(piece) == 'p' && (r == 0 || r == 7))
+      for (char kind : {'Q', 'R', 'B', 'N'}) moves.push_back(move + "=" + piece_of(to_move, kind));
+  };
+
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      char piece = at(position, row, col);
+      if (!owned_by(piece, to_move)) continue;
+
+      auto step = [&](int r, int c) {
+        if (on_board(r, c) && !owned_by(at(position, r, c), to_move)) add(row, col, r, c);
+      };
+      auto slide = [&](const int(&rays)[4][2]) {
+        for (const auto &ray : rays) {
+          for (int r = row + ray[0], c = col + ray[1]; on_board(r, c); r += ray[0], c += ray[1]) {
+            if (owned_by(at(position, r, c), to_move)) break;
+            add(row, col, r, c);
+            if (at(position, r, c) != ' ') break;
+          }
+        }
+      };
+
+      switch (std::tolower(piece)) {
+        case 'n':
+          for (const auto &offset : kKnight) step(row + offset[0], col + offset[1]);
+          break;
+        case 'k':
+          for (const auto &offset : kKing) step(row + offset[0], col + offset[1]);
+          break;
+        case 'b':
+          slide(kDiagonals);
+          break;
+        case 'r':
+          slide(kLines);
+          break;
+        case 'q':
+          slide(kDiagonals);
+          slide(kLines);
+          break;
+        case 'p': {
+          int direction = to_move == Player::White ? -1 : 1;
+          int start_row = to_move == Player::White ? 6 : 1;
+          int r = row + direction;
+          if (!on_board(r, col)) break;
+
+          if (at(position, r, col) == ' ') {
+            add(row, col, r, col);
+            if (row == start_row && at(position, r + direction, col) == ' ') add(row, col, r + direction, col);
+          }
+          for (int c : {col - 1, col + 1})
+            if (on_board(r, c) && owned_by(at(position, r, c), other(to_move))) add(row, col, r, c);
+          break;
+        }
+      }
+    }
+  }
+
+  std::sort(moves.begin(), moves.end());
+  return moves;
+}
+
+std::string random_position(std::mt19937_64 &rng, Player to_move) {
+  const std::string kinds = "PPPPNNBBRRQpppppnnbbrrq";
+
+  for (;;) {
+    std::string position(64, ' ');
+    auto empty_square = [&](bool pawn) {
+      for (;;) {
+        int square = rng() % 64;
+        if (position[square] == ' ' && (!pawn || (square >= 8 && square < 56))) return square;
+      }
+    };
+
+    int white_king = empty_square(false);
+    position[white_king] = 'K';
+    position[empty_square(false)] = 'k';
+
+    int pieces = rng() % 16;
+    for (int i = 0; i < pieces; ++i) {
+      char piece = kinds[rng() % kinds.size()];
+      position[empty_square(std::tolower(piece) == 'p')] = piece;
+    }
+
+    int black_king = position.find('k');
+    bool adjacent = std::abs(white_king / 8 - black_king / 8) <= 1 && std::abs(white_king % 8 - black_king % 8) <= 1;
+    if (!adjacent && !reference_in_check(position, other(to_move))) return position;
+  }
+}
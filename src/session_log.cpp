@@ -0,0 +1,149 @@
+//===----------------------------------------------------------------------===//
+//
+// The session log is written on its own thread: `record` only serializes
+// into a buffer under the lock, the writer swaps the buffer out & does the
+// (possibly slow) file I/O without holding it. A crash loses at most the
+// last 100ms, and `read` drops a record that was only partly written.
+//
+//===----------------------------------------------------------------------===//
+
+#include "session_log.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const char kMagic[] = "CHLOG001";
+const size_t kMagicSize = sizeof(kMagic) - 1;
+const size_t kHeaderSize = 8 + 4 + 1 + 8 + 2;  // everything but the data
+
+template <typename T>
+void put(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(const char *in) {
+  T value;
+  std::memcpy(&value, in, sizeof(value));
+  return value;
+}
+
+uint64_t now_us() {
+  auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(since_epoch).count();
+}
+
+}  // namespace
+
+const size_t SessionLog::kFlushBytes;
+const int SessionLog::kFlushMs;
+
+SessionLog::SessionLog(const std::string &path) : path_(path) {
+  if (path_.empty()) return;
+
+  file_.open(path_, std::ios::binary | std::ios::app);
+  if (!file_) return;
+  file_.seekp(0, std::ios::end);
+  if (file_.tellp() == 0) buffer_.append(kMagic, kMagicSize);  // new log
+
+  writer_ = std::thread(&SessionLog::write_loop, this);
+}
+
+SessionLog::~SessionLog() {
+  if (!writer_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  flush_.notify_all();
+  writer_.join();
+}
+
+void SessionLog::write_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    flush_.wait_for(lock, std::chrono::milliseconds(kFlushMs),
+                    [this] { return stop_ || buffer_.size() >= kFlushBytes; });
+
+    std::string pending;
+    pending.swap(buffer_);
+    bool done = stop_;
+
+    lock.unlock();
+    if (!pending.empty()) {
+      file_.write(pending.data(), pending.size());
+      file_.flush();
+    }
+    if (done) return;
+    lock.lock();
+  }
+}
+
+bool SessionLog::ok() const { return path_.empty() || writer_.joinable(); }
+
+void SessionLog::record(LogKind kind, const std::string &data, uint64_t position, uint32_t latency_us) {
+  std::string payload = data.substr(0, UINT16_MAX);
+  uint64_t time = now_us();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (path_.empty()) {
+    records_.push_back({time, latency_us, kind, position, payload});
+    return;
+  }
+  if (!writer_.joinable()) return;
+
+  put<uint64_t>(buffer_, time);
+  put<uint32_t>(buffer_, latency_us);
+  put<uint8_t>(buffer_, static_cast<uint8_t>(kind));
+  put<uint64_t>(buffer_, position);
+  put<uint16_t>(buffer_, payload.size());
+  buffer_ += payload;
+  if (buffer_.size() >= kFlushBytes) flush_.notify_all();
+}
+
+std::vector<LogRecord> SessionLog::records() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_;
+}
+
+bool SessionLog::read(const std::string &path, std::vector<LogRecord> &records) {
+  std::ifstream file(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (bytes.compare(0, kMagicSize, kMagic, kMagicSize) != 0) return false;
+
+  records.clear();
+  size_t offset = kMagicSize;
+  while (bytes.size() - offset >= kHeaderSize) {
+    const char *in = bytes.data() + offset;
+    LogRecord record;
+    record.time_us = get<uint64_t>(in);
+    record.latency_us = get<uint32_t>(in + 8);
+    record.kind = static_cast<LogKind>(get<uint8_t>(in + 12));
+    record.position = get<uint64_t>(in + 13);
+    size_t size = get<uint16_t>(in + 21);
+
+    if (bytes.size() - offset - kHeaderSize < size || record.kind > LogKind::EngineMove) break;  // torn
+    record.data = bytes.substr(offset + kHeaderSize, size);
+    records.push_back(std::move(record));
+    offset += kHeaderSize + size;
+  }
+  return true;
+}
+
+std::string SessionLog::encode_move(const Move &move, uint64_t searched) {
+  std::string data;
+  put<uint64_t>(data, searched);
+  put<char>(data, move.piece_char());
+  put<uint8_t>(data, move.has_capture());
+  put<uint16_t>(data, move.pack());
+  return data;
+}
+
+std::shared_ptr<Move> SessionLog::decode_move(const std::string &data, uint64_t &searched) {
+  if (data.size() != 12) return nullptr;
+  searched = get<uint64_t>(data.data());
+  return MoveFactory().unpack(get<uint16_t>(data.data() + 10), data[8], data[9] != 0);
+}
@@ -0,0 +1,207 @@
+//===----------------------------------------------------------------------===//
+//
+// Mate-in-N search. `Prover::mating_move` & `Prover::mated` call each other,
+// one per side: the mating side needs one move that works, the defence has
+// to be beaten after every reply. Positions where the mating side was shown
+// not to mate within some number of moves are remembered, so iterative
+// deepening & transpositions don't search them again.
+//
+//===----------------------------------------------------------------------===//
+
+#include "solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+typedef std::shared_ptr<Move> MovePtr;
+
+class Prover {
+  Game game_;
+  std::unordered_map<uint64_t, int> refuted_;  // mating side to move: no mate within this many moves
+  const std::atomic<bool> *stop_ = nullptr;     // another thread found a key
+  uint64_t nodes_ = 0;
+
+  bool stopped() const { return stop_ && *stop_; }
+
+  uint64_t key() const {
+    uint64_t key = game_.hash();
+    if (!game_.beirut_mode()) return key;
+
+    // the hash does not tell bomb carriers apart from other pieces:
+    for (Player p : {Player::White, Player::Black}) {
+      auto detonation = game_.bomb_move(p);
+      uint64_t salt = p == Player::White ? 0x9E3779B97F4A7C15ULL : 0xC2B2AE3D27D4EB4FULL;
+      if (detonation) key ^= salt * (detonation->from().row * 8 + detonation->from().col + 1);
+    }
+    return key;
+  }
+
+ public:
+  explicit Prover(const Game &game) : game_(game) {}
+
+  void set_stop(const std::atomic<bool> *stop) { stop_ = stop; }
+  uint64_t nodes() const { return nodes_; }
+  Game &game() { return game_; }
+
+  // `move` by the mating side, then mate within `n - 1` more of its moves whatever the defence
+  bool mates_after(const MovePtr &move, int n) {
+    Player mover = game_.to_move();
+    game_.make_move(move);
+    game_.swap();
+    bool mates = mated(n);
+    game_.undo();
+    if (game_.to_move() != mover) game_.swap();
+    return mates;
+  }
+
+  // the defence to move is mated within `n - 1` moves of the mating side (at once for n == 1)
+  bool mated(int n) {
+    ++nodes_;
+    if (game_.checkmate(game_.to_move())) return true;
+    if (n == 1 || stopped()) return false;
+
+    auto replies = game_.legal_moves();
+    if (replies.empty()) return false;  // stalemate
+
+    Player defender = game_.to_move();
+    for (const auto &reply : replies) {
+      game_.make_move(reply);
+      game_.swap();
+      bool mates = mating_move(n - 1) != nullptr;
+      game_.undo();
+      if (game_.to_move() != defender) game_.swap();
+      if (!mates) return false;
+    }
+    return true;
+  }
+
+  // a move of the player to move that mates within `n` moves, nullptr if there is none
+  MovePtr mating_move(int n) {
+    ++nodes_;
+    uint64_t position = key();
+    auto known = refuted_.find(position);
+    if (known != refuted_.end() && known->second >= n) return nullptr;
+
+    // checks first: only they can mate at once, and they are the likeliest to mate later
+    auto checks = game_.checking_moves();
+    for (const auto &move : checks)
+      if (mates_after(move, n)) return move;
+
+    if (n > 1) {
+      std::unordered_set<uint16_t> tried;
+      for (const auto &move : checks) tried.insert(move->pack());
+
+      for (const auto &move : game_.legal_moves()) {
+        if (tried.count(move->pack()) || stopped()) continue;
+        if (mates_after(move, n)) return move;
+      }
+    }
+
+    if (!stopped()) refuted_[position] = std::max(n, known == refuted_.end() ? 0 : known->second);
+    return nullptr;
+  }
+
+  // shortest mate within `n` moves, 0 if none
+  int mate_length(int n) {
+    for (int length = 1; length <= n; ++length)
+      if (mating_move(length)) return length;
+    return 0;
+  }
+};
+
+// key & the longest defence against it, until the mate
+std::vector<std::string> main_line(const Game &game, MovePtr key, int n) {
+  Prover prover(game);
+  Game &position = prover.game();
+  std::vector<std::string> line{key->to_string()};
+
+  position.make_move(key);
+  position.swap();
+  for (int left = n - 1; left > 0 && !position.checkmate(position.to_move()); --left) {
+    MovePtr defence;
+    int longest = 0;
+    for (const auto &reply : position.legal_moves()) {
+      position.make_move(reply);
+      position.swap();
+      int length = prover.mate_length(left);
+      position.undo();
+      position.swap();
+      if (length > longest) {
+        longest = length;
+        defence = reply;
+      }
+    }
+    if (!defence) break;
+
+    position.make_move(defence);
+    position.swap();
+    auto attack = prover.mating_move(longest);
+    line.push_back(defence->to_string());
+    line.push_back(attack->to_string());
+    position.make_move(attack);
+    position.swap();
+    left = longest;
+  }
+  return line;
+}
+
+}  // namespace
+
+MateResult solve_mate(const Game &game, int max_moves, int threads, bool all_keys) {
+  MateResult result;
+  if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+  Game root(game);
+  auto checks = root.checking_moves();
+  std::vector<MovePtr> moves = checks;  // checks first, see `Prover::mating_move`
+  std::unordered_set<uint16_t> tried;
+  for (const auto &move : checks) tried.insert(move->pack());
+  for (const auto &move : root.legal_moves())
+    if (!tried.count(move->pack())) moves.push_back(move);
+
+  // one prover per thread for the whole search, so refutations carry over to the next depth:
+  std::vector<std::unique_ptr<Prover>> provers;
+  for (int i = 0; i < threads; ++i) provers.push_back(std::make_unique<Prover>(game));
+
+  for (int n = 1; n <= max_moves && !result.mate; ++n) {
+    size_t candidates = n == 1 ? checks.size() : moves.size();
+    std::vector<char> mates(candidates, 0);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> found(false);
+
+    auto work = [&](Prover &prover) {
+      prover.set_stop(all_keys ? nullptr : &found);
+      for (;;) {
+        if (found && !all_keys) return;
+        size_t i = next++;
+        if (i >= candidates) return;
+
+        if (!prover.mates_after(moves[i], n)) continue;
+        mates[i] = 1;
+        found = true;
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(work, std::ref(*provers[i]));
+    work(*provers[0]);
+    for (auto &worker : workers) worker.join();
+
+    for (size_t i = 0; i < candidates; ++i) {
+      if (!mates[i]) continue;
+      if (!result.mate) result.line = main_line(game, moves[i], n);
+      result.mate = true;
+      result.moves = n;
+      result.keys.push_back(moves[i]->to_string());
+    }
+  }
+
+  for (const auto &prover : provers) result.nodes += prover->nodes();
+  return result;
+}
@@ -0,0 +1,111 @@
+//===----------------------------------------------------------------------===//
+//
+// Per-thread hot-path counters. The `STATS_SCOPE` macro only creates a
+// `ScopedTimer` in instrumented builds; this file is always compiled so the
+// `:s` command & the exit dump can tell whether instrumentation is available.
+// The memory footprint of the game is reported either way.
+//
+//===----------------------------------------------------------------------===//
+
+#include "stats.h"
+
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+Stats &Stats::local() {
+  thread_local Stats stats;
+  return stats;
+}
+
+bool Stats::enabled() {
+#ifdef CHESS_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char *Stats::name(Counter c) {
+  switch (c) {
+    case Counter::TryMove:
+      return "try_move";
+    case Counter::InCheck:
+      return "in_check";
+    case Counter::SubstantivelyValid:
+      return "substantively_valid";
+    case Counter::MakeMove:
+      return "make_move";
+    case Counter::Undo:
+      return "undo";
+    case Counter::Checkmate:
+      return "checkmate";
+    case Counter::MoveFormat:
+      return "move_format";
+    case Counter::ParseMove:
+      return "parse_move";
+    default:
+      return "unknown";
+  }
+}
+
+CounterStats &Stats::operator[](Counter c) { return counters_[static_cast<int>(c)]; }
+
+const CounterStats &Stats::operator[](Counter c) const { return counters_[static_cast<int>(c)]; }
+
+void Stats::reset() {
+  for (auto &counter : counters_) counter = CounterStats();
+  memory_ = MemoryUsage();
+}
+
+void Stats::set_memory(const MemoryUsage &memory) { memory_ = memory; }
+
+uint64_t MemoryUsage::total() const { return board + history + pieces; }
+
+void Stats::report(std::ostream &os) const {
+  os << "memory [bytes]: board " << memory_.board << ", history " << memory_.history << ", pieces "
+     << memory_.pieces << ", total " << memory_.total() << '\n';
+
+  if (!enabled()) {
+    os << "Statistics are disabled in this build (rebuild with `make STATS=1`).\n";
+    return;
+  }
+
+  // formatted on a stream of our own, so the caller's keeps its flags & precision:
+  std::ostringstream table;
+  table << std::left << std::setw(22) << "counter" << std::right << std::setw(12) << "calls" << std::setw(14)
+        << "total [ms]" << std::setw(12) << "avg [ns]" << '\n';
+
+  for (int i = 0; i < static_cast<int>(Counter::Count); ++i) {
+    const CounterStats &counter = counters_[i];
+    double avg = counter.calls ? static_cast<double>(counter.nanos) / counter.calls : 0.0;
+
+    table << std::left << std::setw(22) << name(static_cast<Counter>(i)) << std::right << std::setw(12)
+          << counter.calls << std::setw(14) << std::fixed << std::setprecision(3) << counter.nanos / 1e6
+          << std::setw(12) << std::setprecision(0) << avg << '\n';
+  }
+  os << table.str();
+}
+
+void Stats::dump(std::ostream &os) const {
+  os << "{\"enabled\":" << (enabled() ? "true" : "false") << ",\"counters\":{";
+
+  for (int i = 0; i < static_cast<int>(Counter::Count); ++i) {
+    const CounterStats &counter = counters_[i];
+    os << (i ? "," : "") << '"' << name(static_cast<Counter>(i)) << "\":{\"calls\":" << counter.calls
+       << ",\"nanos\":" << counter.nanos << '}';
+  }
+
+  os << "},\"memory\":{\"board\":" << memory_.board << ",\"history\":" << memory_.history << ",\"pieces\":"
+     << memory_.pieces << ",\"total\":" << memory_.total() << "}}\n";
+}
+
+// Scoped timer
+
+ScopedTimer::ScopedTimer(Counter c) : target_(Stats::local()[c]), start_(std::chrono::steady_clock::now()) {}
+
+ScopedTimer::~ScopedTimer() {
+  auto elapsed = std::chrono::steady_clock::now() - start_;
+  target_.calls++;
+  target_.nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
@@ -0,0 +1,735 @@
+//===----------------------------------------------------------------------===//
+//
+// Endgame tablebases by retrograde analysis. The generator works on plain
+// 64-character boards (the `Game(const std::string &)` format) with its own
+// small move generator, which follows the same rules as the `Piece`
+// validators: no castling or en passant, and a pawn may reach the last row
+// without promoting. Captures & promotions leave a table, their results are
+// looked up in the (recursively generated) smaller tables.
+//
+// Values are propagated backwards ply by ply: a position whose move leads to
+// a loss in n is a win in n + 1; a position whose moves all lead to wins is a
+// loss in 1 + the longest of them. Positions never resolved are draws.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tablebase.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pieces.h"
+
+namespace {
+
+using Squares = std::array<char, 64>;
+
+constexpr const char *kPieceOrder = "KQRBNP";
+constexpr char kMagic[8] = {'C', 'H', 'T', 'B', '0', '0', '0', '1'};
+constexpr int kSignatureSize = 16;
+
+constexpr int kKnightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int kKingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+constexpr int kRookDirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+constexpr int kBishopDirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+// generator bookkeeping per index:
+enum State : uint8_t { kUnknown, kWin, kLoss, kDraw, kIllegal };
+constexpr uint16_t kNone = 0xFFFF;
+
+struct TbMove {
+  int from, to;
+  char promote_to;  // '\0' if no promotion
+};
+
+bool on_board(int row, int col) { return row >= 0 && row < 8 && col >= 0 && col < 8; }
+
+bool owned_by(char c, bool white) { return c != ' ' && (white ? std::isupper(c) : std::islower(c)); }
+
+char colored(char kind, bool white) { return white ? std::toupper(kind) : std::tolower(kind); }
+
+int piece_rank(char c) { return std::strchr(kPieceOrder, std::toupper(c)) - kPieceOrder; }
+
+std::string sort_side(std::string side) {
+  std::sort(side.begin(), side.end(), [](char a, char b) { return piece_rank(a) < piece_rank(b); });
+  return side;
+}
+
+std::string normalize(const std::string &signature) {
+  auto split = signature.find('v');
+  std::string white = signature.substr(0, split);
+  std::string black = signature.substr(split + 1);
+  for (auto &c : white) c = std::toupper(c);
+  for (auto &c : black) c = std::toupper(c);
+  return sort_side(white) + "v" + sort_side(black);
+}
+
+// can the piece on `from` capture on `target` (in the sense of `in_check`)?
+bool attacks(const Squares &squares, int from, int target) {
+  int d_row = target / 8 - from / 8;
+  int d_col = target % 8 - from % 8;
+  char piece = squares[from];
+
+  auto clear_path = [&]() {
+    int row_step = (d_row > 0) - (d_row < 0);
+    int col_step = (d_col > 0) - (d_col < 0);
+    for (int square = from + row_step * 8 + col_step; square != target; square += row_step * 8 + col_step)
+      if (squares[square] != ' ') return false;
+    return true;
+  };
+
+  bool straight = (d_row == 0) != (d_col == 0);
+  bool diagonal = d_row != 0 && std::abs(d_row) == std::abs(d_col);
+
+  switch (std::toupper(piece)) {
+    case 'K':
+      return std::max(std::abs(d_row), std::abs(d_col)) == 1;
+    case 'N':
+      return std::abs(d_row * d_col) == 2;
+    case 'P':
+      return d_row == (std::isupper(piece) ? -1 : 1) && std::abs(d_col) == 1;
+    case 'R':
+      return straight && clear_path();
+    case 'B':
+      return diagonal && clear_path();
+    case 'Q':
+      return (straight || diagonal) && clear_path();
+  }
+
+  return false;
+}
+
+// is `target` attacked by any piece of `by_white`? (only looks at the listed squares)
+bool attacked(const Squares &squares, const int *piece_squares, int count, int target, bool by_white) {
+  for (int i = 0; i < count; ++i)
+    if (owned_by(squares[piece_squares[i]], by_white) && attacks(squares, piece_squares[i], target)) return true;
+  return false;
+}
+
+void pseudo_moves(const Squares &squares, int from, std::vector<TbMove> &out) {
+  char piece = squares[from];
+  bool white = std::isupper(piece);
+  int row = from / 8;
+  int col = from % 8;
+
+  auto add = [&](int r, int c) { out.push_back({from, r * 8 + c, '\0'}); };
+
+  auto steps = [&](const int(*offsets)[2]) {
+    for (int i = 0; i < 8; ++i) {
+      int r = row + offsets[i][0];
+      int c = col + offsets[i][1];
+      if (on_board(r, c) && !owned_by(squares[r * 8 + c], white)) add(r, c);
+    }
+  };
+
+  auto slides = [&](const int(*dirs)[2]) {
+    for (int d = 0; d < 4; ++d) {
+      for (int r = row + dirs[d][0], c = col + dirs[d][1]; on_board(r, c); r += dirs[d][0], c += dirs[d][1]) {
+        if (owned_by(squares[r * 8 + c], white)) break;
+        add(r, c);
+        if (squares[r * 8 + c] != ' ') break;
+      }
+    }
+  };
+
+  switch (std::toupper(piece)) {
+    case 'K':
+      steps(kKingSteps);
+      break;
+    case 'N':
+      steps(kKnightSteps);
+      break;
+    case 'R':
+      slides(kRookDirs);
+      break;
+    case 'B':
+      slides(kBishopDirs);
+      break;
+    case 'Q':
+      slides(kRookDirs);
+      slides(kBishopDirs);
+      break;
+    case 'P': {
+      int direction = white ? -1 : 1;
+      int start_row = white ? 6 : 1;
+      int last_row = white ? 0 : 7;
+
+      auto pawn_to = [&](int r, int c) {
+        add(r, c);  // reaching the last row without promoting is allowed
+        if (r != last_row) return;
+        for (char kind : std::string("NBRQ")) out.push_back({from, r * 8 + c, colored(kind, white)});
+      };
+
+      int r = row + direction;
+      if (!on_board(r, col)) break;
+
+      if (squares[r * 8 + col] == ' ') {
+        pawn_to(r, col);
+        if (row == start_row && squares[(r + direction) * 8 + col] == ' ') add(r + direction, col);
+      }
+
+      for (int c : {col - 1, col + 1})
+        if (on_board(r, c) && owned_by(squares[r * 8 + c], !white)) pawn_to(r, c);
+      break;
+    }
+  }
+}
+
+Squares after_move(const Squares &squares, const TbMove &move) {
+  Squares next = squares;
+  next[move.to] = move.promote_to ? move.promote_to : squares[move.from];
+  next[move.from] = ' ';
+  return next;
+}
+
+Squares mirrored(const Squares &squares) {
+  Squares flipped;
+  for (int i = 0; i < 64; ++i) {
+    char c = squares[(7 - i / 8) * 8 + i % 8];
+    flipped[i] = std::isupper(c) ? std::tolower(c) : std::toupper(c);
+  }
+  return flipped;
+}
+
+// a position resolved at `level`; `claim` marks wins by leaving the table,
+// which only count if the position was not resolved differently before:
+struct Scheduled {
+  int level;
+  uint64_t index;
+  bool claim;
+};
+
+// runs fn(i, out) for all i < count on `threads` workers & collects their `out` lists
+template <typename F>
+std::vector<Scheduled> parallel_for(uint64_t count, unsigned threads, F fn) {
+  const uint64_t kChunk = 4096;
+  std::atomic<uint64_t> next(0);
+  std::vector<std::vector<Scheduled>> outputs(std::max(1u, threads));
+  std::vector<std::thread> workers;
+
+  for (auto &out : outputs) {
+    workers.emplace_back([&]() {
+      for (uint64_t begin = next.fetch_add(kChunk); begin < count; begin = next.fetch_add(kChunk))
+        for (uint64_t i = begin; i < std::min(count, begin + kChunk); ++i) fn(i, out);
+    });
+  }
+
+  for (auto &worker : workers) worker.join();
+
+  std::vector<Scheduled> scheduled;
+  for (const auto &out : outputs) scheduled.insert(scheduled.end(), out.begin(), out.end());
+  return scheduled;
+}
+
+}  // namespace
+
+// Tablebase
+
+Tablebase::Tablebase() : bits_(1) {}
+
+Tablebase::Tablebase(const std::string &signature) : signature_(normalize(signature)), bits_(1) {
+  bool white = true;
+  for (char c : signature_) {
+    if (c == 'v')
+      white = false;
+    else
+      pieces_.push_back(colored(c, white));
+  }
+}
+
+std::string Tablebase::signature_of(const std::string &position) {
+  std::string white, black;
+  for (char c : position.substr(0, 64)) {
+    if (c == ' ') continue;
+    (std::isupper(c) ? white : black) += std::toupper(c);
+  }
+  return sort_side(white) + "v" + sort_side(black);
+}
+
+std::string Tablebase::flipped(const std::string &signature) {
+  auto split = signature.find('v');
+  return signature.substr(split + 1) + "v" + signature.substr(0, split);
+}
+
+bool Tablebase::valid_signature(const std::string &signature) {
+  auto split = signature.find('v');
+  if (split == std::string::npos || signature.find('v', split + 1) != std::string::npos) return false;
+  if (signature.size() - 1 > static_cast<std::size_t>(kMaxPieces)) return false;
+
+  for (const auto &side : {signature.substr(0, split), signature.substr(split + 1)}) {
+    if (std::count_if(side.begin(), side.end(), [](char c) { return std::toupper(c) == 'K'; }) != 1) return false;
+    for (char c : side)
+      if (!std::strchr(kPieceOrder, std::toupper(c))) return false;
+  }
+
+  return true;
+}
+
+const std::string &Tablebase::signature() const { return signature_; }
+
+const std::vector<char> &Tablebase::pieces() const { return pieces_; }
+
+uint64_t Tablebase::entries() const { return (uint64_t(1) << (6 * pieces_.size())) * 2; }
+
+uint64_t Tablebase::index(const std::string &position, bool white_to_move) const {
+  uint64_t used = 0;
+  uint64_t index = 0;
+
+  for (char piece : pieces_) {
+    int square = 0;
+    while (square < 64 && (position[square] != piece || (used >> square & 1))) ++square;
+    used |= uint64_t(1) << square;
+    index = index * 64 + square;
+  }
+
+  return index * 2 + (white_to_move ? 0 : 1);
+}
+
+TbResult Tablebase::result(uint64_t index) const {
+  uint64_t bit = index * bits_;
+  uint64_t word = bit / 64;
+  unsigned offset = bit % 64;
+
+  uint64_t value = data_[word] >> offset;
+  if (offset + bits_ > 64) value |= data_[word + 1] << (64 - offset);
+  value &= (uint64_t(1) << bits_) - 1;
+
+  if (value == 0) return {Wdl::Draw, 0};
+
+  int dtm = static_cast<int>(value) - 1;
+  return {dtm % 2 ? Wdl::Win : Wdl::Loss, dtm};
+}
+
+/* Draws (including illegal placements) are stored as 0, decisive results as
+   dtm + 1. Wins always end after an odd number of plies & losses after an
+   even number, so the parity of the distance encodes who wins. */
+uint16_t Tablebase::encode(Wdl wdl, int dtm) { return wdl == Wdl::Draw ? 0 : static_cast<uint16_t>(dtm + 1); }
+
+void Tablebase::store(const std::vector<uint16_t> &codes) {
+  uint16_t max_code = *std::max_element(codes.begin(), codes.end());
+  bits_ = 1;
+  while ((uint32_t(1) << bits_) <= max_code) ++bits_;
+
+  data_.assign((codes.size() * bits_ + 63) / 64 + 1, 0);  // one spare word for reads across the end
+
+  for (uint64_t i = 0; i < codes.size(); ++i) {
+    uint64_t bit = i * bits_;
+    uint64_t word = bit / 64;
+    unsigned offset = bit % 64;
+
+    data_[word] |= uint64_t(codes[i]) << offset;
+    if (offset + bits_ > 64) data_[word + 1] |= uint64_t(codes[i]) >> (64 - offset);
+  }
+}
+
+bool Tablebase::load(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[8];
+  char signature[kSignatureSize];
+  uint32_t bits;
+  uint64_t words;
+
+  in.read(magic, sizeof(magic));
+  in.read(signature, sizeof(signature));
+  in.read(reinterpret_cast<char *>(&bits), sizeof(bits));
+  in.read(reinterpret_cast<char *>(&words), sizeof(words));
+
+  if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) return false;
+
+  std::string name(signature, strnlen(signature, kSignatureSize));
+  if (!valid_signature(name) || bits == 0 || bits > 16) return false;
+
+  *this = Tablebase(name);
+  bits_ = bits;
+  if (words != (entries() * bits_ + 63) / 64 + 1) return false;
+
+  data_.resize(words);
+  in.read(reinterpret_cast<char *>(data_.data()), words * sizeof(uint64_t));
+  return static_cast<bool>(in);
+}
+
+bool Tablebase::save(const std::string &path) const {
+  char signature[kSignatureSize] = {};
+  std::memcpy(signature, signature_.data(), std::min<std::size_t>(signature_.size(), kSignatureSize));
+  uint32_t bits = bits_;
+  uint64_t words = data_.size();
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(kMagic, sizeof(kMagic));
+  out.write(signature, sizeof(signature));
+  out.write(reinterpret_cast<const char *>(&bits), sizeof(bits));
+  out.write(reinterpret_cast<const char *>(&words), sizeof(words));
+  out.write(reinterpret_cast<const char *>(data_.data()), words * sizeof(uint64_t));
+  return static_cast<bool>(out);
+}
+
+// Tablebase collection
+
+void Tablebases::add(std::shared_ptr<const Tablebase> table) { tables_[table->signature()] = table; }
+
+int Tablebases::load_directory(const std::string &directory) {
+  DIR *dir = opendir(directory.c_str());
+  if (!dir) return 0;
+
+  int loaded = 0;
+  while (dirent *entry = readdir(dir)) {
+    std::string name(entry->d_name);
+    if (name.size() < 4 || name.substr(name.size() - 3) != ".tb") continue;
+
+    auto table = std::make_shared<Tablebase>();
+    if (table->load(directory + "/" + name)) {
+      add(table);
+      loaded++;
+    }
+  }
+
+  closedir(dir);
+  return loaded;
+}
+
+std::shared_ptr<const Tablebase> Tablebases::find(const std::string &signature) const {
+  auto match = tables_.find(signature);
+  return match == tables_.end() ? nullptr : match->second;
+}
+
+std::vector<std::shared_ptr<const Tablebase>> Tablebases::tables() const {
+  std::vector<std::shared_ptr<const Tablebase>> result;
+  for (const auto &table : tables_) result.push_back(table.second);
+  return result;
+}
+
+std::size_t Tablebases::size() const { return tables_.size(); }
+
+bool Tablebases::probe(const std::string &position, Player to_move, TbResult &result) const {
+  std::string signature = Tablebase::signature_of(position);
+  bool white_to_move = (to_move == Player::White);
+
+  if (signature == "KvK") {  // bare kings, no table needed
+    result = {Wdl::Draw, 0};
+    return true;
+  }
+
+  if (auto table = find(signature)) {
+    result = table->result(table->index(position, white_to_move));
+    return true;
+  }
+
+  // the same ending with colors swapped, board mirrored top to bottom:
+  if (auto table = find(Tablebase::flipped(signature))) {
+    Squares squares;
+    std::copy_n(position.begin(), 64, squares.begin());
+    Squares flipped = mirrored(squares);
+
+    result = table->result(table->index(std::string(flipped.begin(), flipped.end()), !white_to_move));
+    return true;
+  }
+
+  return false;
+}
+
+bool Tablebases::probe(const Board &board, Player to_move, TbResult &result) const {
+  std::string position(64, ' ');
+  int pieces = 0;
+
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      if (!board[row][col]) continue;
+      if (++pieces > Tablebase::kMaxPieces) return false;
+      position[row * 8 + col] = board[row][col]->to_char();
+    }
+  }
+
+  return probe(position, to_move, result);
+}
+
+// Generator
+
+TablebaseGenerator::TablebaseGenerator(Tablebases &registry, unsigned threads)
+    : registry_(registry), threads_(std::max(1u, threads)) {}
+
+std::shared_ptr<const Tablebase> TablebaseGenerator::generate(const std::string &signature) {
+  std::string name = normalize(signature);
+  if (name == "KvK") return nullptr;  // always a draw, see `Tablebases::probe`
+
+  if (auto existing = registry_.find(name)) return existing;
+
+  auto table = std::make_shared<Tablebase>(name);
+  const std::vector<char> &pieces = table->pieces();
+  const int count = pieces.size();
+  const int king_index = std::find(pieces.begin(), pieces.end(), 'k') - pieces.begin();  // white's king is first
+
+  // first make sure everything a capture or promotion can lead to exists:
+  std::string white = name.substr(0, name.find('v'));
+  std::string black = name.substr(name.find('v') + 1);
+
+  for (int side = 0; side < 2; ++side) {
+    std::string &own = side ? black : white;
+    std::string &other = side ? white : black;
+
+    for (std::size_t i = 0; i < own.size(); ++i) {
+      if (own[i] == 'K') continue;
+
+      std::string captured = own;
+      captured.erase(i, 1);
+      std::string sub = side ? white + "v" + captured : captured + "v" + black;
+      if (!registry_.find(normalize(sub)) && !registry_.find(Tablebase::flipped(normalize(sub)))) generate(sub);
+
+      if (own[i] != 'P') continue;
+
+      for (char kind : std::string("QRBN")) {
+        std::string promoted = own;
+        promoted[i] = kind;
+        sub = side ? other + "v" + promoted : promoted + "v" + other;
+        if (!registry_.find(normalize(sub)) && !registry_.find(Tablebase::flipped(normalize(sub)))) generate(sub);
+      }
+    }
+  }
+
+  const uint64_t entries = table->entries();
+  std::vector<std::atomic<uint8_t>> state(entries);
+  std::vector<std::atomic<uint8_t>> counter(entries);
+  std::vector<std::atomic<uint16_t>> dtm(entries);
+  std::vector<uint16_t> exit_win(entries, kNone);  // shortest win by leaving the table
+  std::vector<uint16_t> exit_loss(entries, 0);     // longest loss by leaving the table
+
+  auto decode = [&](uint64_t index, int *piece_squares, Squares &squares) {
+    squares.fill(' ');
+    bool valid = true;
+
+    for (int i = count - 1; i >= 0; --i) {
+      piece_squares[i] = (index / 2) >> (6 * (count - 1 - i)) & 63;
+      if (squares[piece_squares[i]] != ' ') valid = false;
+      squares[piece_squares[i]] = pieces[i];
+    }
+
+    return valid;
+  };
+
+  auto encode_index = [&](const int *piece_squares, bool white_to_move) {
+    uint64_t index = 0;
+    for (int i = 0; i < count; ++i) index = index * 64 + piece_squares[i];
+    return index * 2 + (white_to_move ? 0 : 1);
+  };
+
+  // work lists per level, see `Scheduled`:
+  std::vector<std::vector<uint64_t>> resolved, claims;
+  auto schedule = [&](const std::vector<Scheduled> &scheduled) {
+    for (const auto &item : scheduled) {
+      auto &lists = item.claim ? claims : resolved;
+      if (lists.size() <= static_cast<std::size_t>(item.level)) lists.resize(item.level + 1);
+      lists[item.level].push_back(item.index);
+    }
+  };
+
+  // Initialization: count legal moves, find mates & look up moves leaving the table.
+  schedule(parallel_for(entries, threads_, [&](uint64_t index, std::vector<Scheduled> &out) {
+    int piece_squares[Tablebase::kMaxPieces];
+    Squares squares;
+    bool white_to_move = (index % 2 == 0);
+
+    dtm[index].store(kNone, std::memory_order_relaxed);
+    counter[index].store(0, std::memory_order_relaxed);
+
+    if (!decode(index, piece_squares, squares) ||
+        attacked(squares, piece_squares, count, piece_squares[white_to_move ? king_index : 0], white_to_move)) {
+      state[index].store(kIllegal, std::memory_order_relaxed);
+      return;
+    }
+
+    thread_local std::vector<TbMove> moves;
+    moves.clear();
+    for (int i = 0; i < count; ++i)
+      if (owned_by(pieces[i], white_to_move)) pseudo_moves(squares, piece_squares[i], moves);
+
+    int king = piece_squares[white_to_move ? 0 : king_index];
+
+    int legal = 0;
+    int open = 0;  // legal moves staying in the table, not yet refuted
+    bool drawing_exit = false;
+
+    for (const auto &move : moves) {
+      Squares next = after_move(squares, move);
+
+      // pieces after the move (a captured piece's square now holds the mover):
+      int next_squares[Tablebase::kMaxPieces];
+      std::copy_n(piece_squares, count, next_squares);
+      for (int i = 0; i < count; ++i)
+        if (next_squares[i] == move.from) next_squares[i] = move.to;
+
+      if (attacked(next, next_squares, count, move.from == king ? move.to : king, !white_to_move)) continue;
+      legal++;
+
+      if (squares[move.to] == ' ' && !move.promote_to) {
+        open++;
+        continue;
+      }
+
+      // captures & promotions continue in a smaller/different table:
+      TbResult result;
+      registry_.probe(std::string(next.begin(), next.end()), white_to_move ? Player::Black : Player::White, result);
+
+      if (result.wdl == Wdl::Loss)
+        exit_win[index] = std::min<uint16_t>(exit_win[index], result.dtm + 1);
+      else if (result.wdl == Wdl::Win)
+        exit_loss[index] = std::max<uint16_t>(exit_loss[index], result.dtm);
+      else
+        drawing_exit = true;
+    }
+
+    if (legal == 0) {  // checkmate or stalemate
+      bool mated = attacked(squares, piece_squares, count, king, !white_to_move);
+      state[index].store(mated ? kLoss : kDraw, std::memory_order_relaxed);
+      dtm[index].store(0, std::memory_order_relaxed);
+      if (mated) out.push_back({0, index, false});
+      return;
+    }
+
+    // a drawing exit means the position can never be lost, keep the counter from reaching 0:
+    state[index].store(kUnknown, std::memory_order_relaxed);
+    counter[index].store(drawing_exit ? 0xFF : open, std::memory_order_relaxed);
+
+    if (exit_win[index] != kNone) {
+      out.push_back({exit_win[index], index, true});
+    } else if (open == 0 && !drawing_exit) {
+      // every move leaves the table into a win for the opponent:
+      state[index].store(kLoss, std::memory_order_relaxed);
+      dtm[index].store(exit_loss[index] + 1, std::memory_order_relaxed);
+      out.push_back({exit_loss[index] + 1, index, false});
+    }
+  }));
+
+  // Propagation, one ply at a time:
+  for (std::size_t level = 0; level < std::max(resolved.size(), claims.size()); ++level) {
+    resolved.resize(std::max(resolved.size(), level + 1));
+
+    // wins by leaving the table, unless already resolved by a shorter win:
+    if (level < claims.size()) {
+      for (uint64_t index : claims[level]) {
+        uint8_t expected = kUnknown;
+        if (state[index].compare_exchange_strong(expected, kWin)) {
+          dtm[index].store(level, std::memory_order_relaxed);
+          resolved[level].push_back(index);
+        }
+      }
+    }
+
+    std::vector<uint64_t> frontier = std::move(resolved[level]);
+    schedule(parallel_for(frontier.size(), threads_, [&](uint64_t item, std::vector<Scheduled> &out) {
+      uint64_t index = frontier[item];
+      uint8_t result = state[index].load(std::memory_order_relaxed);
+
+      int piece_squares[Tablebase::kMaxPieces];
+      Squares squares;
+      decode(index, piece_squares, squares);
+      bool mover_white = (index % 2 != 0);  // the side that moved into this position
+
+      // every quiet, non-promoting move of the other side that leads here:
+      for (int i = 0; i < count; ++i) {
+        if (!owned_by(pieces[i], mover_white)) continue;
+
+        int to = piece_squares[i];
+        int row = to / 8;
+        int col = to % 8;
+        int origins[27];  // at most a queen's moves
+        int origin_count = 0;
+
+        auto steps = [&](const int(*offsets)[2]) {
+          for (int k = 0; k < 8; ++k) {
+            int r = row + offsets[k][0];
+            int c = col + offsets[k][1];
+            if (on_board(r, c) && squares[r * 8 + c] == ' ') origins[origin_count++] = r * 8 + c;
+          }
+        };
+
+        auto slides = [&](const int(*dirs)[2]) {
+          for (int d = 0; d < 4; ++d)
+            for (int r = row + dirs[d][0], c = col + dirs[d][1]; on_board(r, c) && squares[r * 8 + c] == ' ';
+                 r += dirs[d][0], c += dirs[d][1])
+              origins[origin_count++] = r * 8 + c;
+        };
+
+        switch (std::toupper(pieces[i])) {
+          case 'K':
+            steps(kKingSteps);
+            break;
+          case 'N':
+            steps(kKnightSteps);
+            break;
+          case 'R':
+            slides(kRookDirs);
+            break;
+          case 'B':
+            slides(kBishopDirs);
+            break;
+          case 'Q':
+            slides(kRookDirs);
+            slides(kBishopDirs);
+            break;
+          case 'P': {
+            int direction = mover_white ? -1 : 1;
+            int start_row = mover_white ? 6 : 1;
+            int r = row - direction;
+
+            if (!on_board(r, col) || squares[r * 8 + col] != ' ') break;
+            origins[origin_count++] = r * 8 + col;
+            if (r - direction == start_row && squares[(r - direction) * 8 + col] == ' ')
+              origins[origin_count++] = (r - direction) * 8 + col;
+            break;
+          }
+        }
+
+        for (int k = 0; k < origin_count; ++k) {
+          int from = origins[k];
+          int previous_squares[Tablebase::kMaxPieces];
+          std::copy_n(piece_squares, count, previous_squares);
+          previous_squares[i] = from;
+          uint64_t previous = encode_index(previous_squares, mover_white);
+
+          if (state[previous].load(std::memory_order_relaxed) != kUnknown) continue;
+
+          if (result == kLoss) {
+            uint8_t expected = kUnknown;
+            if (state[previous].compare_exchange_strong(expected, kWin)) {
+              dtm[previous].store(level + 1, std::memory_order_relaxed);
+              out.push_back({static_cast<int>(level) + 1, previous, false});
+            }
+          } else if (counter[previous].fetch_sub(1) == 1 && exit_win[previous] == kNone) {
+            int distance = std::max<int>(level, exit_loss[previous]) + 1;
+            uint8_t expected = kUnknown;
+            if (state[previous].compare_exchange_strong(expected, kLoss)) {
+              dtm[previous].store(distance, std::memory_order_relaxed);
+              out.push_back({distance, previous, false});
+            }
+          }
+        }
+      }
+    }));
+  }
+
+  std::vector<uint16_t> codes(entries);
+  parallel_for(entries, threads_, [&](uint64_t index, std::vector<Scheduled> &) {
+    uint8_t result = state[index].load(std::memory_order_relaxed);
+    int distance = dtm[index].load(std::memory_order_relaxed);
+
+    if (result == kWin)
+      codes[index] = Tablebase::encode(Wdl::Win, distance);
+    else if (result == kLoss)
+      codes[index] = Tablebase::encode(Wdl::Loss, distance);
+    else
+      codes[index] = Tablebase::encode(Wdl::Draw, 0);
+  });
+
+  table->store(codes);
+  registry_.add(table);
+  return table;
+}
@@ -0,0 +1,62 @@
+//===----------------------------------------------------------------------===//
+//
+// Time management: the clock is shared out evenly over the moves expected to
+// remain (`kMovesToGo`), plus most of the increment. An iteration already
+// running may take up to four times that soft limit, but never more than a
+// third of the time left (plus the increment), minus the latency reserve.
+//
+//===----------------------------------------------------------------------===//
+
+#include "timeman.h"
+
+#include <algorithm>
+
+TimeManager::TimeManager()
+    : start_(std::chrono::steady_clock::now()), limited_(false), soft_ms_(0), hard_ms_(0) {}
+
+void TimeManager::start(int64_t time_left, int64_t increment, int64_t movetime) {
+  start_ = std::chrono::steady_clock::now();
+  limited_ = time_left != 0 || movetime > 0;
+  soft_ms_ = hard_ms_ = 0;
+
+  if (time_left > 0) {
+    soft_ms_ = std::max<int64_t>(time_left / kMovesToGo + increment * 3 / 4, 1);  // also below `kMovesToGo` ms
+    hard_ms_ = std::min(soft_ms_ * 4, time_left / 3 + increment);
+    hard_ms_ = std::min(hard_ms_, time_left - kLatencyMs);
+  } else if (time_left < 0) {
+    hard_ms_ = 1;  // flag already fell, move at once
+  }
+
+  if (movetime > 0) {
+    int64_t hard = movetime - kLatencyMs;
+    hard_ms_ = time_left != 0 ? std::min(hard_ms_, hard) : hard;
+    soft_ms_ = time_left != 0 ? std::min(soft_ms_, hard) : hard;
+  }
+
+  // however little time is left, a limited search gets at least 1ms (so it still finds a move):
+  if (limited_) {
+    hard_ms_ = std::max<int64_t>(hard_ms_, 1);
+    soft_ms_ = std::min(std::max<int64_t>(soft_ms_, 1), hard_ms_);
+  }
+}
+
+bool TimeManager::limited() const { return limited_; }
+
+int64_t TimeManager::elapsed() const {
+  auto running = std::chrono::steady_clock::now() - start_;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(running).count();
+}
+
+int64_t TimeManager::soft_limit() const { return soft_ms_; }
+
+int64_t TimeManager::hard_limit() const { return hard_ms_; }
+
+bool TimeManager::out_of_time() const { return limited() && elapsed() >= hard_ms_; }
+
+bool TimeManager::next_iteration(bool unstable) const {
+  if (!limited()) return true;
+
+  // the next iteration takes longer than all before it, so it only gets started in the first half:
+  int64_t limit = unstable ? std::min(soft_ms_ * 2, hard_ms_) : soft_ms_;
+  return elapsed() < limit / 2;
+}
@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+// Batched move validation for callers that are not the interactive game
+// (front ends, analysis tools). A batch is split by position; each group is
+// one task on the worker pool, and the batch completes when its last group
+// has been answered.
+//
+//===----------------------------------------------------------------------===//
+
+#include "validation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "game.h"
+#include "move.h"
+
+namespace {
+
+bool valid_position(const std::string &position) {
+  const std::string allowed = " prnbqkPRNBQK";
+  return position.size() == 64 &&
+         std::all_of(position.begin(), position.end(), [&](char c) { return allowed.find(c) != std::string::npos; });
+}
+
+bool piece_query(const std::string &query) {
+  return query.size() == 3 && std::string("prnbqkPRNBQK").find(query[0]) != std::string::npos && query[1] >= 'a' &&
+         query[1] <= 'h' && query[2] >= '1' && query[2] <= '8';
+}
+
+ValidationResult answer(Game &game, const std::string &query) {
+  ValidationResult result;
+
+  if (piece_query(query)) {
+    result.well_formed = true;
+
+    Field from(8 - (query[2] - '0'), query[1] - 'a');
+    auto piece = game.board()[from.row][from.col];
+    if (!piece || piece->to_char() != query[0]) return result;
+
+    for (const auto &move : game.legal_moves(from)) result.moves.push_back(move->to_string());
+    result.valid = !result.moves.empty();
+    return result;
+  }
+
+  MoveFactory factory;
+  if (!factory.valid(query)) return result;
+
+  result.well_formed = true;
+  result.valid = game.try_move(factory.parse_move(query));
+  return result;
+}
+
+// answers `requests[i]` for every i in `indices`; all of them share one position
+void answer_group(const std::vector<ValidationRequest> &requests, const std::vector<size_t> &indices,
+                  std::vector<ValidationResult> &results) {
+  const auto &first = requests[indices.front()];
+  if (!valid_position(first.position)) return;  // results stay default: not well formed
+
+  Game game(first.position);
+  if (game.to_move() != first.to_move) game.swap();
+
+  for (size_t i : indices) results[i] = answer(game, requests[i].query);
+}
+
+}  // namespace
+
+ValidationService::ValidationService(unsigned threads) : stopping_(false) {
+  threads = std::max(1u, threads);
+  for (unsigned i = 0; i < threads; ++i) workers_.emplace_back(&ValidationService::work, this);
+}
+
+ValidationService::~ValidationService() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &worker : workers_) worker.join();
+}
+
+void ValidationService::work() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) return;  // stopping & drained
+
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+void ValidationService::enqueue(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push(std::move(task));
+  }
+  ready_.notify_one();
+}
+
+size_t ValidationService::threads() const { return workers_.size(); }
+
+void ValidationService::submit(std::vector<ValidationRequest> batch,
+                               std::function<void(std::vector<ValidationResult>)> done) {
+  // group by position & player to move, keeping the order of first appearance:
+  std::map<std::pair<std::string, Player>, size_t> group_of;
+  std::vector<std::vector<size_t>> groups;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    auto key = std::make_pair(batch[i].position, batch[i].to_move);
+    auto it = group_of.find(key);
+    if (it == group_of.end()) {
+      it = group_of.emplace(key, groups.size()).first;
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(i);
+  }
+
+  if (groups.empty()) {
+    done({});
+    return;
+  }
+
+  struct Pending {
+    std::vector<ValidationRequest> requests;
+    std::vector<ValidationResult> results;
+    std::atomic<size_t> remaining;
+    std::function<void(std::vector<ValidationResult>)> done;
+  };
+  auto pending = std::make_shared<Pending>();
+  pending->results.resize(batch.size());
+  pending->requests = std::move(batch);
+  pending->remaining = groups.size();
+  pending->done = std::move(done);
+
+  // groups write disjoint result slots, the last one to finish hands them over:
+  for (auto &group : groups) {
+    enqueue([pending, indices = std::move(group)] {
+      answer_group(pending->requests, indices, pending->results);
+      if (--pending->remaining == 0) pending->done(std::move(pending->results));
+    });
+  }
+}
+
+std::future<std::vector<ValidationResult>> ValidationService::submit(std::vector<ValidationRequest> batch) {
+  auto promise = std::make_shared<std::promise<std::vector<ValidationResult>>>();
+  auto future = promise->get_future();
+  submit(std::move(batch),
+         [promise](std::vector<ValidationResult> results) { promise->set_value(std::move(results)); });
+  return future;
+}
+
+ValidationResult ValidationService::validate(const ValidationRequest &request) {
+  std::vector<ValidationResult> results(1);
+  answer_group({request}, {0}, results);
+  return results.front();
+}
@@ -0,0 +1,70 @@
+//===----------------------------------------------------------------------===//
+//
+// Position hashes for looking up positions in on-disk tables. The keys come
+// from a fixed-seed splitmix64 sequence evaluated at compile time; changing
+// the seed or the piece order invalidates every book/index built before.
+//
+//===----------------------------------------------------------------------===//
+
+#include "zobrist.h"
+
+#include <cstdint>
+
+#include "pieces.h"
+
+namespace {
+
+constexpr const char *kPieceOrder = "PNBRQKpnbrqk";
+
+struct ZobristKeys {
+  uint64_t pieces[12][64];
+  uint64_t black_to_move;
+};
+
+constexpr uint64_t splitmix64(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys make_keys() {
+  ZobristKeys keys{};
+  uint64_t state = 0x43484553534B4559ULL;  // "CHESSKEY"
+
+  for (int piece = 0; piece < 12; ++piece)
+    for (int square = 0; square < 64; ++square) keys.pieces[piece][square] = splitmix64(state);
+
+  keys.black_to_move = splitmix64(state);
+  return keys;
+}
+
+constexpr ZobristKeys kKeys = make_keys();
+
+int piece_index(char piece) {
+  for (int i = 0; i < 12; ++i)
+    if (kPieceOrder[i] == piece) return i;
+  return -1;
+}
+
+}  // namespace
+
+uint64_t zobrist_key(char piece, int square) {
+  int index = piece_index(piece);
+  return index < 0 ? 0 : kKeys.pieces[index][square];
+}
+
+uint64_t zobrist_black_to_move() { return kKeys.black_to_move; }
+
+uint64_t position_hash(const Board &board, Player to_move) {
+  uint64_t hash = (to_move == Player::Black) ? kKeys.black_to_move : 0;
+
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      const auto &ptr = board[row][col];
+      if (ptr) hash ^= zobrist_key(ptr->to_char(), row * 8 + col);
+    }
+  }
+
+  return hash;
+}
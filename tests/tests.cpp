@@ -1,9 +1,27 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include "basics.h"
+#include "book.h"
+#include "engine.h"
 #include "game.h"
 #include "move.h"
 #include "pieces.h"
+#include "play.h"
+#include "position_index.h"
+#include "reference.h"
+#include "session_log.h"
+#include "solver.h"
+#include "stats.h"
+#include "tablebase.h"
+#include "validation.h"
 
 // Game initialization
 // See if initializing w/ defaults or provided state causes issues:
@@ -72,6 +90,70 @@ TEST(ChessTests, CheckmateTest) {
   ASSERT_TRUE(game2->checkmate(Player::White)) << "In CheckmateTest: checkmate by missing king not recognized";
 }
 
+// Branching history
+// Forks share history but move independently, and can jump back to any ply:
+
+TEST(ChessTests, ForkTest) {
+  auto game = std::make_unique<Game>();
+  auto movemaker = std::make_unique<MoveFactory>();
+  std::string start = game->position();
+
+  for (const auto &input : {"Pe2e4", "pe7e5", "Ng1f3"}) {
+    game->make_move(movemaker->parse_move(input));
+    game->swap();
+  }
+  std::string mainline = game->position();
+  ASSERT_EQ(game->ply(), 3);
+
+  Game variation = game->fork(2);
+  ASSERT_EQ(variation.ply(), 2);
+  ASSERT_EQ(variation.to_move(), Player::White) << "In ForkTest: player to move not restored";
+  variation.make_move(movemaker->parse_move("Pd2d4"));
+  variation.swap();
+
+  ASSERT_EQ(game->position(), mainline) << "In ForkTest: fork changed the original";
+  ASSERT_EQ(variation.moves_played().size(), 3u);
+  ASSERT_EQ(variation.moves_played()[2]->to_string(), "Pd2d4");
+  ASSERT_EQ(game->moves_played()[2]->to_string(), "Ng1f3");
+
+  game->jump_to(0);
+  ASSERT_EQ(game->position(), start);
+  ASSERT_EQ(game->to_move(), Player::White);
+  game->undo();  // nothing left to take back
+  ASSERT_EQ(game->ply(), 0);
+}
+
+// Beirut variant
+// Blowing up the attacker is a way out of check, and detonations are undone:
+
+TEST(ChessTests, BeirutTest) {
+  // white king h1 attacked by the queen on g2 (covered by the pawn on f3):
+  std::string position = "k                                            p        q      N K";
+  auto classic = std::make_unique<Game>(position);
+  ASSERT_TRUE(classic->checkmate(Player::White)) << "In BeirutTest: checkmate not recognized";
+
+  auto game = std::make_unique<Game>(position);
+  game->enable_beirut_mode();
+  ASSERT_TRUE(game->give_bomb(Player::White, Field(7, 5)));  // knight on f1 carries the bomb
+  ASSERT_FALSE(game->give_bomb(Player::White, Field(7, 7))) << "In BeirutTest: king accepted as bomber";
+  ASSERT_FALSE(game->checkmate(Player::White)) << "In BeirutTest: detonation not considered";
+
+  auto moves = game->legal_moves();
+  ASSERT_EQ(moves.size(), 1u);
+  ASSERT_TRUE(moves[0]->is_detonation());
+  ASSERT_EQ(moves[0]->to_string(), "boom");
+
+  game->make_move(moves[0]);
+  ASSERT_EQ(game->board()[6][6], nullptr) << "In BeirutTest: queen survived the explosion";
+  ASSERT_FALSE(game->in_check(Player::White));
+  game->undo();
+  ASSERT_EQ(game->position(), position) << "In BeirutTest: detonation not undone";
+
+  // pieces are shared between games, the bomb must stay with this one knight:
+  ASSERT_FALSE(classic->board()[7][5]->carries_bomb()) << "In BeirutTest: bomb shared with another game";
+  ASSERT_FALSE(Game().board()[7][6]->carries_bomb()) << "In BeirutTest: bomb shared with another knight";
+}
+
 // Check recognition
 // See if the game recognizes when a player is in check, and whether it can tell
 // check from checkmate
@@ -89,6 +171,61 @@ TEST(ChessTests, CheckTest) {
   ASSERT_FALSE(game2->checkmate(game2->to_move())) << "In CheckTest: check mistaken for checkmate (2)";
 }
 
+// Attack maps
+// The bitboard attack map agrees with asking every piece for a capture, along a played-out game:
+
+TEST(ChessTests, AttackTest) {
+  Game game;
+
+  for (int ply = 0; ply < 40; ++ply) {
+    Board board = game.board();
+
+    for (Player by : {Player::White, Player::Black}) {
+      Bitboard attacked = game.attacks(by);
+
+      for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+          // a capture needs something to capture, so empty squares get a placeholder:
+          std::string position = game.position();
+          if (position[r * 8 + c] == ' ') position[r * 8 + c] = by == Player::White ? 'n' : 'N';
+          Game probe(position);
+
+          bool scalar = false;
+          for (int row = 0; row < 8 && !scalar; ++row) {
+            for (int col = 0; col < 8 && !scalar; ++col) {
+              auto piece = board[row][col];
+              if (!piece || piece->owner() != by) continue;
+
+              auto attack = std::make_shared<Move>(piece->to_char(), Field(row, col), Field(r, c), true);
+              scalar = (row != r || col != c) && probe.substantively_valid(attack, true);
+            }
+          }
+
+          ASSERT_EQ((attacked & square_bit(Field(r, c))) != 0, scalar)
+              << "In AttackTest: square " << r << c << " at ply " << ply << " in " << game.position();
+        }
+      }
+    }
+
+    // king escapes from the attack map match trying out every king move:
+    Field king = game.kingpos(game.to_move());
+    char king_char = board[king.row][king.col]->to_char();
+    Bitboard escapes = 0;
+    for (int r = 0; r < 8; ++r) {
+      for (int c = 0; c < 8; ++c) {
+        auto move = std::make_shared<Move>(king_char, king, Field(r, c), board[r][c] != nullptr);
+        if ((r != king.row || c != king.col) && game.try_move(move)) escapes |= square_bit(Field(r, c));
+      }
+    }
+    ASSERT_EQ(game.king_escapes(game.to_move()), escapes) << "In AttackTest: king escapes at ply " << ply;
+
+    auto moves = game.legal_moves();
+    if (moves.empty()) break;
+    game.make_move(moves[(ply * 7) % moves.size()]);
+    game.swap();
+  }
+}
+
 // Pawn promotion
 
 TEST(ChessTests, PawnPromotionTest) {
@@ -128,6 +265,778 @@ TEST(ChessTests, GameplayTest) {
   }
 }
 
+// Shared pieces
+// All boards share one prototype per piece, yet promotions & captures only change their own game; a
+// script is played through without clearing the screen:
+
+TEST(ChessTests, SharedPiecesTest) {
+  Game first("rn  kbnrpppPpppp                                PPP PPPPRNBQKBNR");
+  Game second(first);
+  ASSERT_EQ(first.board()[1][3], second.board()[1][3]);
+  ASSERT_EQ(first.board()[1][3], PieceFactory::make_piece('P')) << "In SharedPiecesTest: pawn not shared";
+
+  MoveFactory movemaker;
+  first.make_move(movemaker.parse_move("Pd7d8=Q"));
+  first.swap();
+  ASSERT_EQ(first.board()[0][3]->to_char(), 'Q') << "In SharedPiecesTest: no queen after promotion";
+  ASSERT_EQ(first.board()[1][3], nullptr);
+  ASSERT_EQ(second.board()[1][3]->to_char(), 'P') << "In SharedPiecesTest: promotion changed the other game";
+  ASSERT_EQ(second.board()[0][3], nullptr);
+
+  first.make_move(movemaker.parse_move("pa7a6"));
+  first.swap();
+  auto capture = movemaker.parse_move("Qd8xb8");
+  ASSERT_TRUE(first.try_move(capture)) << "In SharedPiecesTest: capture with the new queen not valid";
+  first.make_move(capture);
+  first.swap();
+  ASSERT_EQ(first.board()[0][1]->to_char(), 'Q');
+  ASSERT_EQ(second.board()[0][1]->to_char(), 'n') << "In SharedPiecesTest: capture changed the other game";
+
+  first.undo();
+  ASSERT_EQ(first.board()[0][1]->to_char(), 'n') << "In SharedPiecesTest: captured knight not restored";
+  ASSERT_EQ(first.board()[0][3]->to_char(), 'Q');
+
+  PlayOptions options;
+  ASSERT_TRUE(parse_options({"--script", "--analysis", "off"}, options));
+  auto events = std::make_shared<EventQueue>();
+  for (const char *line : {"Pe2e4", "pe7e5", "Ng1f3", ":q"}) events->push({Event::Kind::Line, line, nullptr, 0});
+
+  std::ostringstream screen;
+  auto *cout_buffer = std::cout.rdbuf(screen.rdbuf());
+  play(events, options);
+  std::cout.rdbuf(cout_buffer);
+  Game::set_script_mode(false);
+
+  ASSERT_EQ(screen.str().find("\033[H\033[J"), std::string::npos) << "In SharedPiecesTest: screen cleared in a script";
+  ASSERT_EQ(screen.str().find("not valid"), std::string::npos) << "In SharedPiecesTest: scripted move refused";
+  ASSERT_NE(screen.str().rfind("Black's turn"), std::string::npos) << "In SharedPiecesTest: script not played";
+}
+
+// Differential testing
+// `Game` agrees with the plain reference generator (see bin/difftest for millions of positions):
+
+TEST(ChessTests, DifferentialTest) {
+  ASSERT_THROW(Game("rnbqkbnr"), std::invalid_argument) << "In DifferentialTest: short position accepted";
+  ASSERT_THROW(Game(std::string(63, ' ') + "X"), std::invalid_argument) << "In DifferentialTest: unknown piece";
+
+  // a move onto a taken square has to be a capture (and never of an own piece):
+  Game game;
+  MoveFactory movemaker;
+  ASSERT_FALSE(game.try_move(movemaker.parse_move("Ng1e2"))) << "In DifferentialTest: own pawn overwritten";
+  ASSERT_FALSE(game.try_move(movemaker.parse_move("Ng1xe2")));
+
+  std::mt19937_64 rng(42);
+  for (int i = 0; i < 300; ++i) {
+    Player to_move = i % 2 ? Player::Black : Player::White;
+    std::string position = random_position(rng, to_move);
+    Game random(position);
+    if (random.to_move() != to_move) random.swap();
+
+    std::vector<std::string> moves;
+    for (const auto &move : random.legal_moves()) moves.push_back(move->to_string());
+    std::sort(moves.begin(), moves.end());
+    ASSERT_EQ(moves, reference_moves(position, to_move)) << "In DifferentialTest: legal moves of \"" << position << '"';
+    ASSERT_EQ(random.in_check(to_move), reference_in_check(position, to_move)) << "In DifferentialTest: check";
+  }
+}
+
+// Build a tiny book, map it & look up the most played moves; a corrupt header is refused:
+// Build a tiny book, map it & look up the most played moves:
+
+TEST(ChessTests, OpeningBookTest) {
+  BookBuilder builder;
+  ASSERT_TRUE(builder.add_game("Pe2e4 pe7e5 Ng1f3", 20));
+  ASSERT_TRUE(builder.add_game("Pe2e4 pc7c5", 20));
+  ASSERT_TRUE(builder.add_game("Pd2d4 pd7d5", 20));
+  ASSERT_FALSE(builder.add_game("Pe2e4 Pe4e5", 20)) << "In OpeningBookTest: invalid move added to book";
+
+  std::string path = ::testing::TempDir() + "chess_test_book.bin";
+  ASSERT_TRUE(builder.write(path));
+
+  OpeningBook book;
+  ASSERT_TRUE(book.open(path)) << "In OpeningBookTest: could not map book";
+
+  auto game = std::make_unique<Game>();
+  auto entries = book.lookup(game->hash());
+  ASSERT_EQ(entries.size(), 2u) << "In OpeningBookTest: wrong number of book moves";
+  ASSERT_EQ(entries[0].weight, 3) << "In OpeningBookTest: most played move not first";
+
+  auto moves = book.moves(*game);
+  ASSERT_EQ(moves[0]->piece_char(), 'P');
+  ASSERT_EQ(moves[0]->to().row, 4);
+  ASSERT_EQ(moves[0]->to().col, 4);
+
+  auto movemaker = std::make_unique<MoveFactory>();
+  ASSERT_FALSE(book.contains(game->hash(), movemaker->parse_move("Ng1f3")->pack()));
+  ASSERT_TRUE(book.lookup(12345).empty());
+
+  // a count that overflows to the size of the file, without any entries behind the header:
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write("CHBOOK01\0\0\0\0\0\0\0\x10", 16);
+  ASSERT_FALSE(book.open(path)) << "In OpeningBookTest: overflowing entry count accepted";
+  std::remove(path.c_str());
+}
+
+// Position index
+// Runs of one record each force the external merge to take several passes; corrupt files are refused:
+
+TEST(ChessTests, PositionIndexTest) {
+  std::string path = ::testing::TempDir() + "chess_test_index.bin";
+  PositionIndexBuilder builder(path, sizeof(PositionIndexBuilder::Occurrence));
+
+  ASSERT_TRUE(builder.add_game("Pe2e4 pe7e5 Ng1f3"));
+  ASSERT_TRUE(builder.add_game("Ng1f3 ng8f6 Nf3g1 nf6g8 Pe2e4"));  // back to the start, then transposes
+  ASSERT_FALSE(builder.add_game("Pd2d4 Pd4d5")) << "In PositionIndexTest: invalid move indexed";
+  ASSERT_TRUE(builder.add_game(""));
+  ASSERT_TRUE(builder.add_game("Pe2e4 pe7e5 Ng1f3 nb8c6 Bf1c4 ng8f6"));
+  ASSERT_EQ(builder.games(), 5u);
+  ASSERT_EQ(builder.positions(), 20u);
+  ASSERT_TRUE(builder.finish());
+  ASSERT_GT(builder.runs(), 20u) << "In PositionIndexTest: runs not merged in passes";
+
+  PositionIndex index;
+  ASSERT_TRUE(index.open(path)) << "In PositionIndexTest: could not map index";
+
+  Game game;
+  auto games = index.games(game);
+  ASSERT_EQ(games.size(), 5u) << "In PositionIndexTest: start position not in every game";
+  ASSERT_EQ(index.occurrences(game.hash()), 6u);
+  ASSERT_EQ(games[1].game, 1u);
+  ASSERT_EQ(games[1].occurrences, 2) << "In PositionIndexTest: repetition not counted";
+
+  MoveFactory movemaker;
+  game.make_move(movemaker.parse_move("Pe2e4"));
+  game.swap();
+  games = index.games(game);
+  ASSERT_EQ(games.size(), 3u) << "In PositionIndexTest: transposition missed";
+  ASSERT_EQ(games[1].game, 1u);
+  ASSERT_EQ(games[1].first_ply, 5);
+  ASSERT_EQ(games[2].game, 4u);
+
+  ASSERT_TRUE(index.games(12345).empty());
+  ASSERT_EQ(index.occurrences(12345), 0u);
+
+  // corrupt headers: counts that overflow to the size of the file, a key pointing past the postings
+  auto write_index = [&](uint64_t key_count, uint64_t posting_count, const std::vector<IndexKey> &keys) {
+    uint64_t header[4] = {0, key_count, posting_count, 0};
+    std::memcpy(header, "CHPIDX01", 8);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(keys.data()), keys.size() * sizeof(IndexKey));
+    out << std::string(keys.size() * sizeof(IndexPosting), '\0');  // as many postings as keys
+  };
+  write_index(uint64_t(1) << 61, 0, {});  // 2^61 * 24 bytes wrap around to 0
+  ASSERT_FALSE(index.open(path)) << "In PositionIndexTest: overflowing key count accepted";
+  write_index(1, 1, {{7, 5, 1, 1}});
+  ASSERT_TRUE(index.open(path));
+  ASSERT_TRUE(index.games(7).empty()) << "In PositionIndexTest: postings read past the end";
+  std::remove(path.c_str());
+
+  PositionIndexBuilder unwritable(::testing::TempDir() + "no_such_directory/index.bin",
+                                  sizeof(PositionIndexBuilder::Occurrence));
+  ASSERT_FALSE(unwritable.add_game("Pe2e4")) << "In PositionIndexTest: lost run not reported";
+  ASSERT_FALSE(unwritable.ok());
+  ASSERT_FALSE(unwritable.finish());
+}
+
+// Packed moves survive a round trip (including promotions):
+
+TEST(ChessTests, PackedMoveTest) {
+  auto game = std::make_unique<Game>("rn  kbnrpppPpppp                                PPP PPPPRNBQKBNR");
+  auto movemaker = std::make_unique<MoveFactory>();
+  auto move = movemaker->parse_move("Pd7d8=Q");
+  auto unpacked = movemaker->unpack(move->pack(), game->board());
+
+  ASSERT_EQ(unpacked->piece_char(), 'P');
+  ASSERT_TRUE(unpacked->is_promotion());
+  ASSERT_EQ(unpacked->promote_to(), 'Q');
+  ASSERT_EQ(unpacked->pack(), move->pack());
+}
+
+// Memory footprint
+// 100 plies of history cost far more than their packed moves, and unpacking restores the game (& its undo):
+
+TEST(ChessTests, MemoryTest) {
+  Game game;
+  game.enable_beirut_mode();
+  ASSERT_TRUE(game.give_bomb(Player::White, Field(6, 4)));
+  MemoryUsage fresh = game.memory_usage();
+  ASSERT_EQ(fresh.history, sizeof(std::shared_ptr<const HistoryNode>)) << "In MemoryTest: history without moves";
+  ASSERT_GT(fresh.pieces, 0u) << "In MemoryTest: bomb carrier not counted";
+
+  // knights back & forth, plus the carrier's pawn:
+  MoveFactory movemaker;
+  std::vector<std::string> moves = {"Pe2e4", "pe7e5"};
+  for (int i = 0; i < 49; ++i) {
+    bool out = i % 2 == 0;
+    moves.push_back(out ? "Ng1f3" : "Nf3g1");
+    moves.push_back(out ? "ng8f6" : "nf6g8");
+  }
+  for (const auto &input : moves) {
+    game.make_move(movemaker.parse_move(input));
+    game.swap();
+  }
+  ASSERT_EQ(game.ply(), 100);
+
+  MemoryUsage usage = game.memory_usage();
+  ASSERT_EQ(usage.board, fresh.board);
+  ASSERT_EQ(usage.pieces, fresh.pieces) << "In MemoryTest: carrier counted more than once";
+  ASSERT_GT(usage.history, 100 * sizeof(HistoryNode));
+  ASSERT_LE(sizeof(UndoRecord), 2 * sizeof(UndoRecord::Square) + 16) << "In MemoryTest: room for a blast in every move";
+
+  PackedGame packed = game.pack();
+  ASSERT_LT(packed.bytes() * 10, usage.total()) << "In MemoryTest: packed game not much smaller";
+
+  Game unpacked = Game::unpack(packed);
+  ASSERT_EQ(unpacked.hash(), game.hash()) << "In MemoryTest: position not restored";
+  ASSERT_EQ(unpacked.to_move(), game.to_move());
+  ASSERT_EQ(unpacked.ply(), 100);
+  ASSERT_TRUE(unpacked.beirut_mode());
+  ASSERT_NE(unpacked.bomb_move(Player::White), nullptr) << "In MemoryTest: bomb carrier lost";
+
+  unpacked.jump_to(0);
+  ASSERT_EQ(unpacked.hash(), Game().hash()) << "In MemoryTest: undo after unpacking";
+
+  std::ostringstream dump;
+  Stats::local().set_memory(usage);
+  Stats::local().dump(dump);
+  ASSERT_NE(dump.str().find("\"total\":" + std::to_string(usage.total())), std::string::npos)
+      << "In MemoryTest: memory missing from the dump";
+}
+
+// Endgame tablebases
+// Generate KRvK & check some known positions, also through `Game::checkmate` & the engine:
+
+// generated once, for every test that needs it
+std::shared_ptr<const Tablebases> krvk_tablebases() {
+  static std::shared_ptr<const Tablebases> tablebases = [] {
+    auto generated = std::make_shared<Tablebases>();
+    TablebaseGenerator(*generated, 2).generate("KRvK");
+    return generated;
+  }();
+  return tablebases;
+}
+
+TEST(ChessTests, TablebaseTest) {
+  auto tablebases = krvk_tablebases();
+  ASSERT_NE(tablebases->find("KRvK"), nullptr);
+
+  TbResult result;
+  // black king on a8 mated by rook h8, supported by king b6:
+  std::string mate = "k      R         K                                              ";
+  ASSERT_TRUE(tablebases->probe(mate, Player::Black, result));
+  ASSERT_EQ(result.wdl, Wdl::Loss) << "In TablebaseTest: mate not recognized";
+  ASSERT_EQ(result.dtm, 0);
+
+  // the same with the rook still on h1, white mates in one:
+  std::string mate_in_one = "k                K                                             R";
+  ASSERT_TRUE(tablebases->probe(mate_in_one, Player::White, result));
+  ASSERT_EQ(result.wdl, Wdl::Win);
+  ASSERT_EQ(result.dtm, 1) << "In TablebaseTest: wrong distance to mate";
+
+  // colors swapped are answered by the same table:
+  std::string flipped = "       r                                 k              K       ";
+  ASSERT_TRUE(tablebases->probe(flipped, Player::Black, result));
+  ASSERT_EQ(result.wdl, Wdl::Win);
+  ASSERT_EQ(result.dtm, 1);
+
+  // stalemate is a draw, more pieces are not covered:
+  std::string stalemate = "                                                       Rk K     ";
+  ASSERT_TRUE(tablebases->probe(stalemate, Player::Black, result));
+  ASSERT_EQ(result.wdl, Wdl::Draw);
+  ASSERT_FALSE(tablebases->probe(mate.substr(0, 63) + "Q", Player::Black, result));
+
+  auto game = std::make_unique<Game>(mate);
+  game->set_tablebases(tablebases);
+  ASSERT_TRUE(game->checkmate(Player::Black)) << "In TablebaseTest: checkmate not taken from tablebase";
+
+  // tables survive a round trip through a file:
+  std::string path = ::testing::TempDir() + "KRvK.tb";
+  ASSERT_TRUE(tablebases->find("KRvK")->save(path));
+  Tablebase loaded;
+  ASSERT_TRUE(loaded.load(path));
+  ASSERT_EQ(loaded.result(loaded.index(mate_in_one, true)).dtm, 1);
+  std::remove(path.c_str());
+}
+
+// Move generation & engine
+// All 20 opening moves are found, a mate in one is found (with the search heuristics in far fewer
+// nodes than without), and tablebases are followed:
+
+TEST(ChessTests, EngineTest) {
+  auto game = std::make_unique<Game>();
+  ASSERT_EQ(game->legal_moves().size(), 20u) << "In EngineTest: wrong number of opening moves";
+
+  auto movemaker = std::make_unique<MoveFactory>();
+  ASSERT_EQ(movemaker->parse_move("Nf3xd4")->to_string(), "Nf3xd4");
+  ASSERT_EQ(movemaker->parse_move("Pd7d8=Q")->to_string(), "Pd7d8=Q");
+
+  auto mate_in_one = std::make_unique<Game>("r  r  k   q bpp    p   p ppn     P BP   P     Q     RPPPR     K ");
+  EngineConfig config;
+  ASSERT_TRUE(EngineConfig::parse("depth=2", config));
+  ASSERT_FALSE(EngineConfig::parse("depth=x", config));
+  Engine engine(config);
+
+  auto move = engine.best_move(*mate_in_one);
+  ASSERT_NE(move, nullptr);
+  mate_in_one->make_move(move);
+  mate_in_one->swap();
+  ASSERT_TRUE(mate_in_one->checkmate(mate_in_one->to_move())) << "In EngineTest: mate in one missed";
+
+  // search heuristics can be switched off one by one, and the name round-trips:
+  ASSERT_TRUE(EngineConfig::parse("depth=3,no-lmr,no-null", config));
+  ASSERT_FALSE(config.lmr);
+  ASSERT_TRUE(config.killers);
+  ASSERT_EQ(config.name(), "depth=3,no-null,no-lmr");
+  ASSERT_FALSE(EngineConfig::parse("depth=3,no-magic", config)) << "In EngineTest: unknown heuristic accepted";
+
+  mate_in_one->undo();
+  mate_in_one->swap();
+  ASSERT_TRUE(EngineConfig::parse("depth=2,no-tt,no-mvv,no-killers,no-history,no-null,no-lmr,no-qs", config));
+  move = Engine(config).best_move(*mate_in_one);
+  mate_in_one->make_move(move);
+  mate_in_one->swap();
+  ASSERT_TRUE(mate_in_one->checkmate(mate_in_one->to_move())) << "In EngineTest: mate in one missed (plain search)";
+  mate_in_one->undo();
+  mate_in_one->swap();
+
+  // "lmr" switches one back on; with all of them (null moves & reductions only start at depth 4) the same
+  // depth takes far fewer nodes & finds the same mate:
+  ASSERT_TRUE(EngineConfig::parse("depth=4,no-lmr,lmr,no-qs", config));
+  ASSERT_TRUE(config.lmr);
+  ASSERT_TRUE(config.null_move);
+  ASSERT_FALSE(config.quiescence);
+  Engine heuristics(config);
+  auto with = heuristics.best_move(*mate_in_one);
+  ASSERT_TRUE(EngineConfig::parse("depth=4,no-tt,no-mvv,no-killers,no-history,no-null,no-lmr,no-qs", config));
+  Engine plain(config);
+  auto without = plain.best_move(*mate_in_one);
+  ASSERT_EQ(with->to_string(), without->to_string()) << "In EngineTest: heuristics changed the best move";
+  ASSERT_LT(heuristics.nodes() * 4, plain.nodes()) << "In EngineTest: heuristics save little";
+
+  // with tablebases, even a depth-1 search takes the shortest way to mate (KRvK, mate in 23 plies):
+  std::string endgame(64, ' ');
+  endgame[3 * 8 + 4] = 'k';
+  endgame[5 * 8 + 3] = 'K';
+  endgame[7 * 8 + 7] = 'R';
+  auto tablebases = krvk_tablebases();
+  TbResult result;
+  ASSERT_TRUE(tablebases->probe(endgame, Player::White, result));
+  ASSERT_EQ(result.dtm, 23);
+
+  Game krvk(endgame);
+  krvk.set_tablebases(tablebases);
+  ASSERT_TRUE(EngineConfig::parse("depth=1", config));
+  move = Engine(config).best_move(krvk);
+  krvk.make_move(move);
+  krvk.swap();
+  ASSERT_TRUE(tablebases->probe(krvk.position(), Player::Black, result));
+  ASSERT_EQ(result.wdl, Wdl::Loss);
+  ASSERT_EQ(result.dtm, 22) << "In EngineTest: tablebase move not played, " << move->to_string();
+}
+
+// Perft
+// Move sequences from the start (the standard counts, no castling or en passant this shallow), and
+// captures are exactly the legal moves that take something, minus promotions:
+
+TEST(ChessTests, PerftTest) {
+  Game game;
+  ASSERT_EQ(game.perft(1), 20u) << "In PerftTest: depth 1";
+  ASSERT_EQ(game.perft(2), 400u) << "In PerftTest: depth 2";
+  ASSERT_EQ(game.perft(3), 8902u) << "In PerftTest: depth 3";
+  ASSERT_EQ(game.ply(), 0) << "In PerftTest: moves left on the board";
+
+  std::mt19937_64 rng(11);
+  for (int i = 0; i < 200; ++i) {
+    Player to_move = i % 2 ? Player::Black : Player::White;
+    Game random(random_position(rng, to_move));
+    if (random.to_move() != to_move) random.swap();
+
+    std::vector<std::string> expected, captures;
+    for (const auto &move : random.legal_moves())
+      if (move->has_capture() && !move->is_promotion()) expected.push_back(move->to_string());
+    for (const auto &move : random.captures()) captures.push_back(move->to_string());
+    ASSERT_EQ(captures, expected) << "In PerftTest: captures of \"" << random.position() << '"';
+  }
+}
+
+// Mate solver
+// Checks are generated exactly; mates are found at their shortest, with every key, detonations included:
+
+TEST(ChessTests, MateSolverTest) {
+  std::mt19937_64 rng(7);
+  for (int i = 0; i < 200; ++i) {
+    Game random(random_position(rng, Player::White));
+    if (random.to_move() != Player::White) random.swap();
+
+    std::vector<std::string> expected, checks;
+    for (const auto &move : random.legal_moves()) {
+      random.make_move(move);
+      bool check = random.in_check(Player::Black) || !random.kingpos(Player::Black).valid();
+      random.undo();
+      if (check) expected.push_back(move->to_string());
+    }
+    for (const auto &move : random.checking_moves()) checks.push_back(move->to_string());
+    std::sort(expected.begin(), expected.end());
+    std::sort(checks.begin(), checks.end());
+    ASSERT_EQ(checks, expected) << "In MateSolverTest: checks of \"" << random.position() << '"';
+  }
+
+  const std::string empty(8, ' ');
+  Game back_rank("      k      ppp" + empty + empty + empty + empty + empty + "R     K ");
+  MateResult result = solve_mate(back_rank, 3);
+  ASSERT_TRUE(result.mate && result.moves == 1) << "In MateSolverTest: back rank mate not found";
+  ASSERT_EQ(result.line, std::vector<std::string>{"Ra1a8"});
+
+  // two keys (the other rook cuts off the 7th rank first), same answer on any number of threads:
+  Game rollers("       k" + empty + "R       " + " R      " + empty + empty + empty + "      K ");
+  for (int threads : {1, 3}) {
+    result = solve_mate(rollers, 2, threads, true);
+    ASSERT_TRUE(result.mate && result.moves == 2) << "In MateSolverTest: mate in 2 not found";
+    ASSERT_EQ(result.keys, (std::vector<std::string>{"Ra6a7", "Rb5b7"})) << "In MateSolverTest: keys";
+    ASSERT_EQ(result.line.size(), 3u) << "In MateSolverTest: no main line";
+  }
+  ASSERT_FALSE(solve_mate(rollers, 1).mate) << "In MateSolverTest: mate in 1 where there is none";
+
+  // Beirut variant: blowing up the checking rook defends, and a carrier next to the king mates
+  Game defended("      k  p   ppp" + empty + empty + empty + empty + empty + "R     K ");
+  defended.enable_beirut_mode();
+  ASSERT_TRUE(solve_mate(defended, 1).mate);
+  ASSERT_TRUE(defended.place_bomb(Field(1, 1)));
+  ASSERT_FALSE(solve_mate(defended, 2).mate) << "In MateSolverTest: detonation as defence ignored";
+
+  Game bomber("       k      N " + empty + empty + empty + empty + empty + "K       ");
+  bomber.enable_beirut_mode();
+  ASSERT_TRUE(bomber.place_bomb(Field(1, 6)));
+  result = solve_mate(bomber, 1);
+  ASSERT_TRUE(result.mate && result.line == std::vector<std::string>{"boom"}) << "In MateSolverTest: detonation mate";
+}
+
+// Analysis
+// Every move gets a score, best first; a mate in one comes out on top, and one search for all moves saves work:
+
+TEST(ChessTests, AnalysisTest) {
+  Game mate_in_one("r  r  k   q bpp    p   p ppn     P BP   P     Q     RPPPR     K ");
+  EngineConfig config;
+  ASSERT_TRUE(EngineConfig::parse("depth=2", config));
+  Engine engine(config);
+
+  auto scores = engine.analyze(mate_in_one);
+  ASSERT_EQ(scores.size(), mate_in_one.legal_moves().size()) << "In AnalysisTest: moves missing";
+  for (size_t i = 1; i < scores.size(); ++i)
+    ASSERT_GE(scores[i - 1].score, scores[i].score) << "In AnalysisTest: not best first";
+  ASSERT_GT(scores.front().score, Engine::kMateScore - 10) << "In AnalysisTest: mate not found";
+
+  mate_in_one.make_move(scores.front().move);
+  mate_in_one.swap();
+  ASSERT_TRUE(mate_in_one.checkmate(mate_in_one.to_move())) << "In AnalysisTest: best move does not mate";
+  mate_in_one.undo();
+  mate_in_one.swap();
+
+  // one piece only (the queen on g3):
+  Field queen(5, 6);
+  auto piece_scores = engine.analyze(mate_in_one, queen);
+  ASSERT_EQ(piece_scores.size(), mate_in_one.legal_moves(queen).size());
+  ASSERT_GT(piece_scores.size(), 0u);
+  for (const auto &entry : piece_scores) ASSERT_EQ(entry.move->from().col, queen.col) << "In AnalysisTest: other piece";
+
+  // one tree for all moves against a search per move, each to the same depth with a table of its own:
+  EngineConfig per_move;
+  ASSERT_TRUE(EngineConfig::parse("depth=4", config));
+  ASSERT_TRUE(EngineConfig::parse("depth=3", per_move));
+  Game start;
+  Engine shared(config);
+  shared.analyze(start);
+
+  uint64_t separate_nodes = 0;
+  for (const auto &move : start.legal_moves()) {
+    start.make_move(move);
+    start.swap();
+    Engine separate(per_move);
+    separate.best_move(start);
+    separate_nodes += separate.nodes();
+    start.undo();
+    start.swap();
+  }
+  ASSERT_LT(shared.nodes(), separate_nodes) << "In AnalysisTest: one shared search saves nothing";
+}
+
+// Pondering
+// The expected reply is searched in the background & answers the next `best_move`; any other reply is searched anew:
+
+TEST(ChessTests, PonderTest) {
+  EngineConfig config;
+  ASSERT_TRUE(EngineConfig::parse("depth=3", config));
+  Engine engine(config);
+
+  for (bool hit : {true, false}) {
+    Game game;
+    auto move = engine.best_move(game);
+    game.make_move(move);
+    game.swap();
+
+    auto expected = engine.expected_reply(game);
+    ASSERT_NE(expected, nullptr) << "In PonderTest: no expected reply";
+    ASSERT_TRUE(engine.ponder(game));
+
+    uint64_t hits = engine.ponder_hits();
+    auto replies = game.legal_moves();
+    auto reply = hit ? expected : replies.back();
+    if (!hit && reply->to_string() == expected->to_string()) reply = replies.front();
+    game.make_move(reply);
+    game.swap();
+
+    move = engine.best_move(game);
+    ASSERT_NE(move, nullptr);
+    ASSERT_TRUE(game.try_move(move)) << "In PonderTest: invalid move after " << (hit ? "hit" : "miss");
+    ASSERT_EQ(engine.ponder_hits(), hits + (hit ? 1 : 0)) << "In PonderTest: hit not recognized";
+  }
+
+  // cancelling ends the search with a move all the same:
+  std::atomic<bool> cancel(true);
+  Game game;
+  ASSERT_NE(engine.best_move(game, &cancel), nullptr) << "In PonderTest: cancelled search without a move";
+}
+
+// Time management
+// Clocks run for the player to move only; the engine keeps to its time & node limits:
+
+TEST(ChessTests, TimeManagementTest) {
+  TimeControl control;
+  ASSERT_TRUE(TimeControl::parse("5+3", control));
+  ASSERT_EQ(control.base_ms, 300000);
+  ASSERT_EQ(control.increment_ms, 3000);
+  ASSERT_EQ(control.name(), "5+3");
+  ASSERT_FALSE(TimeControl::parse("5", control)) << "In TimeManagementTest: no increment accepted";
+  ASSERT_FALSE(TimeControl::parse("0+1", control));
+
+  Game game;
+  ASSERT_FALSE(game.has_clock());
+  game.set_time_control({1000, 100});
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_LE(game.time_left(Player::White), 980) << "In TimeManagementTest: clock not running";
+  ASSERT_EQ(game.time_left(Player::Black), 1000) << "In TimeManagementTest: both clocks running";
+
+  MoveFactory movemaker;
+  game.make_move(movemaker.parse_move("Pe2e4"));
+  game.swap();
+  game.punch_clock();
+  ASSERT_LE(game.time_left(Player::White), 1080);
+  ASSERT_GT(game.time_left(Player::White), 1000) << "In TimeManagementTest: no increment";
+  ASSERT_FALSE(game.flagged(Player::White));
+
+  // budgets: the soft limit is an even share of the clock, the hard one stays clear of the flag
+  TimeManager timer;
+  ASSERT_FALSE(timer.limited());
+  timer.start(60000, 0, 0);
+  ASSERT_EQ(timer.soft_limit(), 60000 / TimeManager::kMovesToGo);
+  ASSERT_EQ(timer.hard_limit(), 4 * timer.soft_limit());
+  timer.start(60, 0, 0);
+  ASSERT_LE(timer.hard_limit(), 60 - TimeManager::kLatencyMs) << "In TimeManagementTest: hard limit past the flag";
+  timer.start(60000, 0, 100);
+  ASSERT_EQ(timer.hard_limit(), 100 - TimeManager::kLatencyMs);
+  for (int64_t left : {1, 10, 25}) {  // less than a millisecond per move to go
+    timer.start(left, 0, 0);
+    ASSERT_TRUE(timer.limited()) << "In TimeManagementTest: no limit with " << left << "ms left";
+    ASSERT_GE(timer.hard_limit(), 1);
+    ASSERT_LE(timer.hard_limit(), std::max<int64_t>(left - TimeManager::kLatencyMs, 1));
+  }
+
+  // a deep search still answers within its move time:
+  EngineConfig config;
+  ASSERT_TRUE(EngineConfig::parse("depth=30,movetime=100", config));
+  ASSERT_EQ(config.name(), "depth=30,movetime=100");
+  Game middlegame("r  r  k   q bpp    p   p ppn     P BP   P     Q     RPPPR     K ");
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_NE(Engine(config).best_move(middlegame), nullptr);
+  auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  ASSERT_LE(took.count(), 100) << "In TimeManagementTest: move time exceeded";
+
+  // ... and a nearly empty clock:
+  ASSERT_TRUE(EngineConfig::parse("depth=6", config));
+  Game low_on_time(middlegame);
+  low_on_time.set_time_control({25, 0});
+  start = std::chrono::steady_clock::now();
+  ASSERT_NE(Engine(config).best_move(low_on_time), nullptr);
+  took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  ASSERT_LT(took.count(), 25) << "In TimeManagementTest: flag fell on a small clock";
+
+  // node limits are exact & give the same move every time:
+  ASSERT_TRUE(EngineConfig::parse("depth=30,nodes=3000", config));
+  Engine first(config), second(config);
+  auto a = first.best_move(middlegame), b = second.best_move(middlegame);
+  ASSERT_EQ(first.nodes(), 3000u) << "In TimeManagementTest: node limit not kept";
+  ASSERT_EQ(a->to_string(), b->to_string()) << "In TimeManagementTest: node-limited search not deterministic";
+}
+
+// Session log
+// Records survive a round trip through the file (appended, a torn end dropped), and a scripted
+// session replays to the same positions, a move typed ahead after the engine's:
+
+TEST(ChessTests, SessionLogTest) {
+  std::string path = ::testing::TempDir() + "chess_test_session.log";
+  std::remove(path.c_str());
+
+  MoveFactory movemaker;
+  Move reply("pe7e5");
+  Game game;
+  uint64_t searched = game.hash();
+  {
+    SessionLog log(path);
+    ASSERT_TRUE(log.ok()) << "In SessionLogTest: could not open the log";
+    log.record(LogKind::Start, std::string("--engine\0depth=2\0", 17), 0);
+    log.record(LogKind::Line, "Pe2e4", 42, 1500);
+    log.record(LogKind::EngineMove, SessionLog::encode_move(reply, searched), 43, 20000);
+  }
+  {
+    SessionLog log(path);  // appends
+    log.record(LogKind::Line, ":q", 43);
+  }
+  std::ofstream(path, std::ios::binary | std::ios::app) << "torn";
+
+  std::vector<LogRecord> records;
+  ASSERT_TRUE(SessionLog::read(path, records)) << "In SessionLogTest: log not recognized";
+  ASSERT_EQ(records.size(), 4u) << "In SessionLogTest: records lost or torn end kept";
+  ASSERT_EQ(records[1].kind, LogKind::Line);
+  ASSERT_EQ(records[1].data, "Pe2e4");
+  ASSERT_EQ(records[1].position, 42u);
+  ASSERT_EQ(records[1].latency_us, 1500u) << "In SessionLogTest: latency lost";
+  ASSERT_EQ(records[3].data, ":q") << "In SessionLogTest: appended record lost";
+
+  uint64_t decoded_searched = 0;
+  auto decoded = SessionLog::decode_move(records[2].data, decoded_searched);
+  ASSERT_TRUE(decoded && decoded->to_string() == reply.to_string()) << "In SessionLogTest: engine move garbled";
+  ASSERT_EQ(decoded_searched, searched);
+  std::remove(path.c_str());
+
+  // a scripted engine takes its move from the queue; the log holds the position after every event, in the
+  // order they were handled:
+  PlayOptions options;
+  ASSERT_TRUE(parse_options({"--script", "--analysis", "off"}, options));
+  options.opponent.scripted = true;
+  options.log = std::make_shared<SessionLog>("");
+
+  game.make_move(movemaker.parse_move("Pe2e4"));
+  game.swap();
+  auto events = std::make_shared<EventQueue>();
+  events->push({Event::Kind::Line, "Pe2e4", nullptr, 0});
+  events->push({Event::Kind::Line, "Pd2d4", nullptr, 0});  // while the engine is to move
+  events->push({Event::Kind::EngineMove, "", decoded, game.hash()});
+  events->push({Event::Kind::EndOfInput, "", nullptr, 0});
+
+  std::ostringstream screen;
+  auto *cout_buffer = std::cout.rdbuf(screen.rdbuf());
+  play(events, options);
+  std::cout.rdbuf(cout_buffer);
+  Game::set_script_mode(false);
+
+  uint64_t after_line = game.hash();
+  game.make_move(decoded);
+  game.swap();
+  records = options.log->records();
+  ASSERT_EQ(records.size(), 3u) << "In SessionLogTest: replayed session not logged";
+  ASSERT_EQ(records[0].position, after_line) << "In SessionLogTest: wrong position after the line";
+  ASSERT_EQ(records[1].kind, LogKind::EngineMove);
+  ASSERT_EQ(records[1].position, game.hash()) << "In SessionLogTest: engine move not replayed";
+
+  game.make_move(movemaker.parse_move("Pd2d4"));
+  game.swap();
+  ASSERT_EQ(records[2].data, "Pd2d4");
+  ASSERT_EQ(records[2].position, game.hash()) << "In SessionLogTest: move typed ahead dropped";
+}
+
+// Cancelled searches
+// After :n the engine (white) searches the start position again; the report of the search :n cancelled is dropped:
+
+TEST(ChessTests, CancelledSearchTest) {
+  PlayOptions options;
+  ASSERT_TRUE(parse_options({"--script", "--analysis", "off", "--engine", "depth=2", "--engine-white"}, options));
+  options.log = std::make_shared<SessionLog>("");
+
+  // stands in for the cancelled search, whose move would be valid at the start position as well:
+  auto events = std::make_shared<EventQueue>();
+  events->push({Event::Kind::Line, ":n", nullptr, 0});
+  events->push({Event::Kind::EngineMove, "", nullptr, Game().hash()});
+  events->push({Event::Kind::EndOfInput, "", nullptr, 0});
+
+  std::ostringstream screen;
+  auto *cout_buffer = std::cout.rdbuf(screen.rdbuf());
+  play(events, options);
+  std::cout.rdbuf(cout_buffer);
+  Game::set_script_mode(false);
+
+  ASSERT_EQ(screen.str().find("No valid moves left"), std::string::npos) << "In CancelledSearchTest: stale move played";
+  auto records = options.log->records();
+  ASSERT_EQ(records.size(), 2u) << "In CancelledSearchTest: engine moves lost or played twice";
+  ASSERT_EQ(records[0].data, ":n");
+  ASSERT_EQ(records[1].kind, LogKind::EngineMove);
+  ASSERT_FALSE(records[1].data.empty()) << "In CancelledSearchTest: the new search did not reply";
+}
+
+// Validation service
+// A batch over two positions is answered in request order, by any number of workers:
+
+TEST(ChessTests, ValidationTest) {
+  std::string start = Game().position();
+  Game game;
+  MoveFactory movemaker;
+  for (const auto &input : {"Pe2e4", "pe7e5", "Bf1c4", "nb8c6", "Qd1f3", "ng8h6"}) {
+    game.make_move(movemaker.parse_move(input));
+    game.swap();
+  }
+  std::string scholars = game.position();  // Qf3xf7 mates
+
+  std::vector<ValidationRequest> batch = {
+      {start, Player::White, "Pe2e4"},  {start, Player::White, "Pe2e5"}, {scholars, Player::White, "Qf3xf7"},
+      {start, Player::White, "Ng1"},    {start, Player::White, "Nd4"},   {start, Player::Black, "pe7e5"},
+      {start, Player::White, "nonsense"}, {"too short", Player::White, "Pe2e4"},
+  };
+
+  ValidationService service(2);
+  auto results = service.submit(batch).get();
+  ASSERT_EQ(results.size(), batch.size());
+
+  ASSERT_TRUE(results[0].valid) << "In ValidationTest: valid pawn move rejected";
+  ASSERT_FALSE(results[1].valid) << "In ValidationTest: invalid pawn move accepted";
+  ASSERT_TRUE(results[2].valid) << "In ValidationTest: queen capture rejected";
+  ASSERT_EQ(results[3].moves, (std::vector<std::string>{"Ng1f3", "Ng1h3"})) << "In ValidationTest: knight moves";
+  ASSERT_FALSE(results[4].valid);  // no knight on d4
+  ASSERT_TRUE(results[5].valid) << "In ValidationTest: player to move not respected";
+  ASSERT_FALSE(results[6].well_formed);
+  ASSERT_FALSE(results[7].well_formed) << "In ValidationTest: short position accepted";
+
+  for (size_t i = 0; i < batch.size(); ++i)
+    ASSERT_EQ(ValidationService::validate(batch[i]).valid, results[i].valid) << "In ValidationTest: request " << i;
+}
+
+// Hot-path counters
+// Only count when instrumented (`make STATS=1`), but the dump has to stay
+// machine-readable either way, and the report must not change the caller's stream formatting:
+
+TEST(ChessTests, StatsTest) {
+  Stats::local().reset();
+
+  auto game = std::make_unique<Game>();
+  auto movemaker = std::make_unique<MoveFactory>();
+  auto move = movemaker->parse_move("Pe2e4");
+  game->try_move(move);
+
+  uint64_t expected = Stats::enabled() ? 1 : 0;
+  ASSERT_EQ(Stats::local()[Counter::TryMove].calls, expected) << "In StatsTest: try_move not counted";
+  ASSERT_EQ(Stats::local()[Counter::MakeMove].calls, expected) << "In StatsTest: make_move not counted";
+
+  std::ostringstream dump;
+  Stats::local().dump(dump);
+  ASSERT_NE(dump.str().find("\"try_move\":{\"calls\":" + std::to_string(expected)), std::string::npos)
+      << "In StatsTest: unexpected dump format";
+
+  std::ostringstream report;
+  auto flags = report.flags();
+  auto precision = report.precision();
+  Stats::local().report(report);
+  ASSERT_EQ(report.flags(), flags) << "In StatsTest: report changed the stream's formatting";
+  ASSERT_EQ(report.precision(), precision);
+}
+
 /**********************/
 /* Runnning the tests */
 /**********************/
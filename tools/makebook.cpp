@@ -0,0 +1,50 @@
+//===----------------------------------------------------------------------===//
+//
+// Builds an opening book from a game collection. The collection is a text
+// file with one game per line, moves in the same notation the game accepts
+// (e.g. `Pe2e4 pe7e5 Ng1f3`). Only the first `max_plies` moves of every game
+// are added.
+//
+// Usage: makebook <games.txt> <book.bin> [max_plies]
+//
+//===----------------------------------------------------------------------===//
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "book.h"
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <games.txt> <book.bin> [max_plies]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream games(argv[1]);
+  if (!games) {
+    std::cerr << "Could not open " << argv[1] << '\n';
+    return EXIT_FAILURE;
+  }
+
+  int max_plies = argc > 3 ? std::stoi(argv[3]) : 20;
+  BookBuilder builder;
+  std::string line;
+  std::size_t line_number = 0;
+
+  while (std::getline(games, line)) {
+    line_number++;
+    if (line.empty()) continue;
+
+    if (!builder.add_game(line, max_plies))
+      std::cerr << "Line " << line_number << ": invalid move, only using the valid prefix\n";
+  }
+
+  if (!builder.write(argv[2])) {
+    std::cerr << "Could not write " << argv[2] << '\n';
+    return EXIT_FAILURE;
+  }
+
+  std::cout << builder.games() << " games, " << builder.entries() << " book entries written to " << argv[2] << '\n';
+  return EXIT_SUCCESS;
+}
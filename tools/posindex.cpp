@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+// Builds & queries a position index over a game archive (one game per line,
+// moves in input notation, as for `makebook`). Game ids are 0-based line
+// numbers. The build sorts in runs of at most `--memory` megabytes, so the
+// archive does not have to fit in memory.
+//
+// Usage: posindex build <games.txt> <index.bin> [--memory MB] [--max-plies N]
+//        posindex query <index.bin> [moves...]            position after the moves
+//        posindex query <index.bin> --board <64 chars> [w|b]
+//
+//===----------------------------------------------------------------------===//
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "game.h"
+#include "move.h"
+#include "position_index.h"
+
+namespace {
+
+void usage(const char *name) {
+  std::cerr << "Usage: " << name << " build <games.txt> <index.bin> [--memory MB] [--max-plies N]\n"
+            << "       " << name << " query <index.bin> [moves...]\n"
+            << "       " << name << " query <index.bin> --board <64 chars> [w|b]\n";
+}
+
+int build(int argc, char **argv) {
+  std::ifstream games(argv[2]);
+  if (!games) {
+    std::cerr << "Could not open " << argv[2] << '\n';
+    return EXIT_FAILURE;
+  }
+
+  std::size_t memory_mb = 64;
+  int max_plies = 1000;
+  for (int i = 4; i + 1 < argc; i += 2) {
+    std::string arg(argv[i]);
+    if (arg == "--memory") memory_mb = std::stoul(argv[i + 1]);
+    if (arg == "--max-plies") max_plies = std::stoi(argv[i + 1]);
+  }
+
+  PositionIndexBuilder builder(argv[3], memory_mb << 20);
+  std::string line;
+
+  while (std::getline(games, line)) {
+    // ids are line numbers, so empty & broken lines still take one:
+    if (builder.add_game(line, max_plies)) continue;
+    if (!builder.ok()) {
+      std::cerr << "Could not write a sorted run next to " << argv[3] << '\n';
+      return EXIT_FAILURE;
+    }
+    std::cerr << "Line " << builder.games() << ": invalid move, only using the valid prefix\n";
+  }
+
+  if (!builder.finish()) {
+    std::cerr << "Could not write " << argv[3] << '\n';
+    return EXIT_FAILURE;
+  }
+
+  PositionIndex index;
+  index.open(argv[3]);
+  std::cout << builder.games() << " games, " << builder.positions() << " positions (" << index.size()
+            << " distinct) from " << builder.runs() << " sorted runs written to " << argv[3] << '\n';
+  return EXIT_SUCCESS;
+}
+
+int query(int argc, char **argv) {
+  PositionIndex index;
+  if (!index.open(argv[2])) {
+    std::cerr << "Could not open index " << argv[2] << '\n';
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<Game> game;
+  if (argc > 4 && std::string(argv[3]) == "--board") {
+    try {
+      game = std::make_unique<Game>(argv[4]);
+    } catch (const std::invalid_argument &error) {
+      std::cerr << "Invalid board (" << error.what() << "): 64 characters, row 8 first, ' ' for empty squares\n";
+      return EXIT_FAILURE;
+    }
+    if (argc > 5 && std::string(argv[5]) == "b") game->swap();
+  } else {
+    game = std::make_unique<Game>();
+    MoveFactory movemaker;
+
+    for (int i = 3; i < argc; ++i) {
+      if (!movemaker.valid(argv[i]) || !game->try_move(movemaker.parse_move(argv[i]))) {
+        std::cerr << "Invalid move " << argv[i] << '\n';
+        return EXIT_FAILURE;
+      }
+      game->make_move(movemaker.parse_move(argv[i]));
+      game->swap();
+    }
+  }
+
+  auto games = index.games(*game);
+  std::cout << games.size() << " games, reached " << index.occurrences(game->hash()) << " times\n";
+  for (const auto &posting : games)
+    std::cout << "game " << posting.game << "  first at ply " << posting.first_ply << "  x" << posting.occurrences
+              << '\n';
+
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string command = argc > 1 ? argv[1] : "";
+
+  if (command == "build" && argc >= 4) return build(argc, argv);
+  if (command == "query" && argc >= 3) return query(argc, argv);
+
+  usage(argv[0]);
+  return EXIT_FAILURE;
+}
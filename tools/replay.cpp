@@ -0,0 +1,168 @@
+//===----------------------------------------------------------------------===//
+//
+// Replays the sessions of a session log (`chess --log <file>`): every
+// session is set up again from its recorded arguments, its lines of input
+// & engine moves are fed to `play` in their recorded order, and the
+// position after each of them must match the recorded one. The engine does
+// not search (its moves are in the log), clocks are off. Prints the first
+// divergence, if any, and latency percentiles of the recorded & replayed
+// session; the exit code says whether all sessions replayed identically.
+//
+// Usage: replay [-v] <log>   (-v shows the replayed games)
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "events.h"
+#include "play.h"
+#include "session_log.h"
+
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+};
+
+std::vector<std::string> split_arguments(const std::string &data) {
+  std::vector<std::string> args;
+  size_t start = 0;
+  for (size_t end; (end = data.find('\0', start)) != std::string::npos; start = end + 1)
+    args.push_back(data.substr(start, end - start));
+  return args;
+}
+
+void print_latencies(const std::string &what, std::vector<uint32_t> latencies) {
+  if (latencies.empty()) return;
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](int p) { return latencies[(latencies.size() - 1) * p / 100] / 1000.0; };
+  std::cerr << "  " << what << " (" << latencies.size() << "): p50 " << percentile(50) << "ms, p90 " << percentile(90)
+            << "ms, p99 " << percentile(99) << "ms, max " << percentile(100) << "ms\n";
+}
+
+const char *kind_name(LogKind kind) {
+  switch (kind) {
+    case LogKind::Start:
+      return "start";
+    case LogKind::Line:
+      return "line";
+    case LogKind::Bomber:
+      return "bomber";
+    case LogKind::EngineMove:
+      return "engine move";
+  }
+  return "?";
+}
+
+// replays one session (`records` start with its `Start`), false if it diverged
+bool replay(const std::vector<LogRecord> &records, int number) {
+  // the session's arguments, without the log (we would append to it):
+  std::vector<std::string> args = split_arguments(records[0].data);
+  auto log_flag = std::find(args.begin(), args.end(), "--log");
+  if (log_flag != args.end()) args.erase(log_flag, std::min(log_flag + 2, args.end()));
+
+  PlayOptions options;
+  if (!parse_options(args, options)) return false;
+  options.opponent.scripted = options.opponent.engine != nullptr;
+  options.opponent.engine = nullptr;
+  options.opponent.ponder = false;
+  options.time_control = TimeControl();  // no clocks, the replay is faster than the session was
+  options.log = std::make_shared<SessionLog>("");
+  options.log->record(LogKind::Start, records[0].data, 0);  // so the records line up
+
+  auto events = std::make_shared<EventQueue>();
+  for (size_t i = 1; i < records.size(); ++i) {
+    const LogRecord &record = records[i];
+    if (record.kind != LogKind::EngineMove) {
+      events->push({Event::Kind::Line, record.data, nullptr, 0});
+      continue;
+    }
+    uint64_t searched = 0;
+    auto move = SessionLog::decode_move(record.data, searched);
+    events->push({Event::Kind::EngineMove, "", move, searched});
+  }
+  events->push({Event::Kind::EndOfInput, "", nullptr, 0});
+
+  try {
+    play(events, options);
+  } catch (...) {
+    std::cerr << "Session " << number << ": the game loop threw\n";
+    return false;
+  }
+
+  std::vector<LogRecord> replayed = options.log->records();
+  bool identical = true;
+  for (size_t i = 1; i < records.size() && identical; ++i) {
+    if (i >= replayed.size()) {
+      std::cerr << "Session " << number << ": replay ended before record " << i << '\n';
+      identical = false;
+    } else if (replayed[i].kind != records[i].kind || replayed[i].data != records[i].data ||
+               replayed[i].position != records[i].position) {
+      std::cerr << "Session " << number << ": record " << i << " (" << kind_name(records[i].kind);
+      if (records[i].kind != LogKind::EngineMove) std::cerr << " \"" << records[i].data << '"';
+      std::cerr << ") diverged\n";
+      identical = false;
+    }
+  }
+  if (identical && replayed.size() > records.size()) {
+    std::cerr << "Session " << number << ": replay has records the session does not\n";
+    identical = false;
+  }
+
+  std::vector<uint32_t> recorded_lines, recorded_moves, replayed_lines;
+  for (const auto &record : records) {
+    if (record.kind == LogKind::Line) recorded_lines.push_back(record.latency_us);
+    if (record.kind == LogKind::EngineMove) recorded_moves.push_back(record.latency_us);
+  }
+  for (const auto &record : replayed)
+    if (record.kind == LogKind::Line) replayed_lines.push_back(record.latency_us);
+
+  std::cerr << "Session " << number << ": " << records.size() - 1 << " records, "
+            << (identical ? "identical" : "DIVERGED") << '\n';
+  print_latencies("recorded input", recorded_lines);
+  print_latencies("recorded engine moves", recorded_moves);
+  print_latencies("replayed input", replayed_lines);
+  return identical;
+}
+
+int main(int argc, char **argv) {
+  bool verbose = false;
+  std::string path;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "-v") {
+      verbose = true;
+    } else {
+      path = arg;
+    }
+  }
+
+  std::vector<LogRecord> records;
+  if (path.empty() || !SessionLog::read(path, records)) {
+    std::cerr << "Usage: replay [-v] <log>, a session log written by chess --log\n";
+    return EXIT_FAILURE;
+  }
+
+  Game::set_script_mode(true);
+  if (!verbose) std::cout.rdbuf(new NullBuffer);  // never freed, `std::cout` is flushed after static destructors ran
+
+  // one session per `Start` record (logs are appended to):
+  bool all_identical = true;
+  int sessions = 0;
+  for (size_t begin = 0; begin < records.size();) {
+    size_t end = begin + 1;
+    while (end < records.size() && records[end].kind != LogKind::Start) ++end;
+    if (records[begin].kind == LogKind::Start) {
+      std::vector<LogRecord> session(records.begin() + begin, records.begin() + end);
+      all_identical = replay(session, ++sessions) && all_identical;
+    }
+    begin = end;
+  }
+
+  if (sessions == 0) std::cerr << "No sessions in " << path << '\n';
+  return all_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,222 @@
+//===----------------------------------------------------------------------===//
+//
+// Plays a match between two engine configurations, games running in
+// parallel (every game has its own `Game` & engines, nothing is shared but
+// the read-only opening book). Colors alternate between games. Writes one
+// line per game to `<prefix>.results`, the moves of every game to
+// `<prefix>.games` (usable as input for bin/makebook), and prints an Elo
+// estimate & SPRT verdict for engine A.
+//
+// Usage: selfplay [-n games] [-j threads] [-a engine] [-b engine] [--beirut]
+//                 [--max-plies N] [--book file] [--seed S] [--out prefix]
+//                 [--elo0 E] [--elo1 E]
+//        engines are "random" or "depth=N"
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "book.h"
+#include "engine.h"
+#include "game.h"
+
+struct GameRecord {
+  std::string white, black;
+  double white_score = 0.5;  // 1, 0.5 or 0
+  std::string result = "1/2-1/2";
+  std::vector<std::string> moves;
+};
+
+// picks a random bomb carrier, like a player would with `Game::get_bomber`
+void choose_bomber(Game &game, Player p, std::mt19937 &rng) {
+  std::vector<Field> candidates;
+  int first_row = (p == Player::White) ? 6 : 0;
+
+  for (int row = first_row; row <= first_row + 1; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      auto piece = game.board()[row][col];
+      if (piece && piece->owner() == p && std::tolower(piece->to_char()) != 'k') candidates.push_back(Field(row, col));
+    }
+  }
+
+  if (!candidates.empty()) game.give_bomb(p, candidates[rng() % candidates.size()]);
+}
+
+GameRecord play_game(const EngineConfig &white, const EngineConfig &black, bool beirut, int max_plies,
+                     std::shared_ptr<const OpeningBook> book, uint32_t seed) {
+  std::mt19937 rng(seed);
+  Engine white_engine(white, rng());
+  Engine black_engine(black, rng());
+  white_engine.set_book(book);
+  black_engine.set_book(book);
+
+  GameRecord record;
+  record.white = white.name();
+  record.black = black.name();
+
+  Game game;
+  if (beirut) {
+    game.enable_beirut_mode();
+    choose_bomber(game, Player::White, rng);
+    choose_bomber(game, Player::Black, rng);
+  }
+
+  for (int ply = 0; ply < max_plies; ++ply) {
+    Player mover = game.to_move();
+    Engine &engine = (mover == Player::White) ? white_engine : black_engine;
+    auto move = engine.best_move(game);
+
+    if (!move) break;  // stalemate (mates are caught below)
+
+    record.moves.push_back(move->to_string());
+    game.make_move(move);
+    game.swap();
+
+    if (game.checkmate(game.to_move())) {
+      record.white_score = (mover == Player::White) ? 1.0 : 0.0;
+      record.result = (mover == Player::White) ? "1-0" : "0-1";
+      break;
+    }
+  }
+
+  return record;
+}
+
+// Elo difference for a score fraction:
+double elo(double score) { return -400.0 * std::log10(1.0 / score - 1.0); }
+
+int usage(const char *name) {
+  std::cerr << "Usage: " << name << " [-n games] [-j threads] [-a engine] [-b engine] [--beirut]\n"
+            << "       [--max-plies N] [--book file] [--seed S] [--out prefix] [--elo0 E] [--elo1 E]\n"
+            << "       engines are \"random\" or \"depth=N\", at least one game\n";
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  int games = 100;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  EngineConfig config_a, config_b;
+  config_b.depth = 0;
+  bool beirut = false;
+  int max_plies = 200;
+  uint32_t seed = 1;
+  std::string prefix = "selfplay";
+  double elo0 = 0.0, elo1 = 5.0;
+  auto book = std::make_shared<OpeningBook>();
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+      bool has_value = i + 1 < argc;
+
+      if (arg == "-n" && has_value) {
+        games = std::stoi(argv[++i]);
+      } else if (arg == "-j" && has_value) {
+        threads = std::max(1, std::stoi(argv[++i]));
+      } else if ((arg == "-a" || arg == "-b") && has_value) {
+        if (!EngineConfig::parse(argv[++i], arg == "-a" ? config_a : config_b)) {
+          std::cerr << "Invalid engine " << argv[i] << " (expected \"random\" or \"depth=N\")\n";
+          return EXIT_FAILURE;
+        }
+      } else if (arg == "--beirut") {
+        beirut = true;
+      } else if (arg == "--max-plies" && has_value) {
+        max_plies = std::stoi(argv[++i]);
+      } else if (arg == "--book" && has_value) {
+        if (!book->open(argv[++i])) std::cerr << "Could not open opening book " << argv[i] << ", continuing without\n";
+      } else if (arg == "--seed" && has_value) {
+        seed = std::stoul(argv[++i]);
+      } else if (arg == "--out" && has_value) {
+        prefix = argv[++i];
+      } else if (arg == "--elo0" && has_value) {
+        elo0 = std::stod(argv[++i]);
+      } else if (arg == "--elo1" && has_value) {
+        elo1 = std::stod(argv[++i]);
+      } else {
+        std::cerr << "Unknown argument " << arg << '\n';
+        return usage(argv[0]);
+      }
+    }
+  } catch (const std::logic_error &) {  // a number that is none (`std::stoi` & co.)
+    return usage(argv[0]);
+  }
+  if (games < 1) return usage(argv[0]);
+
+  std::shared_ptr<const OpeningBook> shared_book = book->is_open() ? book : nullptr;
+  std::vector<GameRecord> records(games);
+  std::atomic<int> next(0);
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&]() {
+      for (int id = next++; id < games; id = next++) {
+        bool a_white = (id % 2 == 0);
+        records[id] = play_game(a_white ? config_a : config_b, a_white ? config_b : config_a, beirut, max_plies,
+                                shared_book, seed + id);
+      }
+    });
+  }
+
+  for (auto &worker : workers) worker.join();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // write results & game records:
+  std::ofstream results(prefix + ".results");
+  std::ofstream collection(prefix + ".games");
+  int wins = 0, draws = 0, losses = 0;  // from engine A's view
+
+  for (int id = 0; id < games; ++id) {
+    const GameRecord &record = records[id];
+    results << id << ' ' << record.white << ' ' << record.black << ' ' << record.result << ' ' << record.moves.size()
+            << '\n';
+
+    for (std::size_t i = 0; i < record.moves.size(); ++i) collection << (i ? " " : "") << record.moves[i];
+    collection << '\n';
+
+    double a_score = (id % 2 == 0) ? record.white_score : 1.0 - record.white_score;
+    if (a_score == 1.0)
+      wins++;
+    else if (a_score == 0.0)
+      losses++;
+    else
+      draws++;
+  }
+
+  // Elo estimate with 95% bounds & SPRT log-likelihood ratio (normal approximation):
+  double n = games;
+  double score = (wins + 0.5 * draws) / n;
+  double variance = (wins * std::pow(1.0 - score, 2) + draws * std::pow(0.5 - score, 2) + losses * std::pow(score, 2)) / n;
+  double margin = 1.96 * std::sqrt(variance / n);
+
+  auto expected = [](double e) { return 1.0 / (1.0 + std::pow(10.0, -e / 400.0)); };
+  double s0 = expected(elo0), s1 = expected(elo1);
+  double llr = variance > 0 ? n * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance) : 0.0;
+  double lower = std::log(0.05 / 0.95), upper = std::log(0.95 / 0.05);
+
+  std::cout << "A: " << config_a.name() << "  B: " << config_b.name() << (beirut ? "  (Beirut)" : "") << '\n'
+            << games << " games in " << elapsed << " s (" << games / elapsed * 3600 << " games/h, " << threads
+            << " threads)\n"
+            << "A: +" << wins << " =" << draws << " -" << losses << "  score " << score << '\n';
+
+  if (score > 0 && score < 1)
+    std::cout << "Elo " << elo(score) << " [" << elo(std::max(1e-6, score - margin)) << ", "
+              << elo(std::min(1 - 1e-6, score + margin)) << "]\n";
+  else
+    std::cout << "Elo unbounded (no games " << (score == 0 ? "won" : "lost") << " by A)\n";
+
+  std::cout << "SPRT elo0=" << elo0 << " elo1=" << elo1 << ": LLR " << llr << " [" << lower << ", " << upper << "] "
+            << (llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "continue") << '\n';
+
+  return EXIT_SUCCESS;
+}
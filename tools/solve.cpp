@@ -0,0 +1,122 @@
+//===----------------------------------------------------------------------===//
+//
+// Checks mate-in-N puzzles (see solver.h). One puzzle per line: the
+// position (64 characters, as taken by `Game(const std::string &)`), the
+// side to move (w or b), N, and for the Beirut variant the bomb carriers
+// like they are picked in the game (e.g. "Qd1 nb8"). Empty lines & lines
+// starting with '#' are skipped. A puzzle is sound if it is a mate in N,
+// not less, with a single key move; the exit code says whether all are.
+//
+// Usage: solve [-j threads] [--first] [puzzles]   (stdin without a file;
+//        --first stops at the first key instead of checking it is unique)
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "game.h"
+#include "solver.h"
+
+// sets `game` up from a puzzle line & reads its N, false (& why) if malformed
+bool parse_puzzle(const std::string &line, Game &game, int &max_moves, std::string &error) {
+  if (line.size() < 64) {
+    error = "position shorter than 64 characters";
+    return false;
+  }
+
+  try {
+    game = Game(line.substr(0, 64));
+  } catch (const std::invalid_argument &) {
+    error = "unknown piece in position";
+    return false;
+  }
+
+  std::istringstream rest(line.substr(64));
+  std::string side;
+  if (!(rest >> side >> max_moves) || (side != "w" && side != "b") || max_moves < 1) {
+    error = "expected side to move (w or b) & N after the position";
+    return false;
+  }
+  if ((side == "w") != (game.to_move() == Player::White)) game.swap();
+
+  for (std::string bomber; rest >> bomber;) {
+    if (!game.beirut_mode()) game.enable_beirut_mode();
+    Field at(8 - (bomber.size() == 3 ? bomber[2] - '0' : 0), bomber.size() == 3 ? bomber[1] - 'a' : -1);
+    bool on_board = at.row >= 0 && at.row < 8 && at.col >= 0 && at.col < 8;
+    auto piece = on_board ? game.board()[at.row][at.col] : nullptr;
+    if (!piece || piece->to_char() != bomber[0] || !game.place_bomb(at)) {
+      error = "no bomb carrier " + bomber;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int threads = 0;
+  bool all_keys = true;
+  std::string path;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "-j" && i + 1 < argc) {
+      threads = std::stoi(argv[++i]);
+    } else if (arg == "--first") {
+      all_keys = false;
+    } else {
+      path = arg;
+    }
+  }
+
+  std::ifstream file;
+  if (!path.empty()) {
+    file.open(path);
+    if (!file) {
+      std::cerr << "Could not open " << path << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+  std::istream &input = path.empty() ? std::cin : file;
+
+  int puzzles = 0, sound = 0;
+  for (std::string line; std::getline(input, line);) {
+    if (line.empty() || line[0] == '#') continue;
+    ++puzzles;
+
+    Game game;
+    int max_moves = 0;
+    std::string error;
+    if (!parse_puzzle(line, game, max_moves, error)) {
+      std::cout << "#" << puzzles << ": " << error << '\n';
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MateResult result = solve_mate(game, max_moves, threads, all_keys);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "#" << puzzles << ": ";
+    if (!result.mate) {
+      std::cout << "no mate in " << max_moves;
+    } else {
+      std::cout << "mate in " << result.moves << ':';
+      for (const auto &move : result.line) std::cout << ' ' << move;
+      if (result.moves < max_moves) std::cout << " (shorter than " << max_moves << ')';
+      if (result.keys.size() > 1) {
+        std::cout << " (" << result.keys.size() << " keys:";
+        for (const auto &key : result.keys) std::cout << ' ' << key;
+        std::cout << ')';
+      }
+      if (result.moves == max_moves && result.keys.size() == 1) ++sound;
+    }
+    std::cout << " [" << elapsed << " ms, " << result.nodes << " nodes]\n";
+  }
+
+  std::cout << sound << " of " << puzzles << " puzzles sound\n";
+  return sound == puzzles ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,66 @@
+//===----------------------------------------------------------------------===//
+//
+// Generates endgame tablebases (up to four pieces) into a directory, one
+// `<signature>.tb` file per table. Tables needed for captures & promotions
+// are generated as well; tables already in the directory are reused.
+//
+// Usage: tbgen <directory> <signature>... [-j threads]
+//        e.g. tbgen tb KQvK KRvK KPvK
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tablebase.h"
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <directory> <signature>... [-j threads]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::string directory = argv[1];
+  unsigned threads = std::thread::hardware_concurrency();
+  std::vector<std::string> signatures;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string arg(argv[i]);
+
+    if (arg == "-j" && i + 1 < argc) {
+      threads = std::stoi(argv[++i]);
+      continue;
+    }
+
+    if (!Tablebase::valid_signature(arg)) {
+      std::cerr << "Invalid signature " << arg << " (expected e.g. KQvK, at most " << Tablebase::kMaxPieces
+                << " pieces)\n";
+      return EXIT_FAILURE;
+    }
+    signatures.push_back(arg);
+  }
+
+  Tablebases registry;
+  int existing = registry.load_directory(directory);
+  if (existing) std::cout << "Reusing " << existing << " tables from " << directory << '\n';
+
+  TablebaseGenerator generator(registry, threads);
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &signature : signatures) generator.generate(signature);
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (const auto &table : registry.tables()) {
+    std::string path = directory + "/" + table->signature() + ".tb";
+    if (!table->save(path)) {
+      std::cerr << "Could not write " << path << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << registry.size() << " tables in " << directory << " (" << elapsed << " s with " << threads
+            << " threads)\n";
+  return EXIT_SUCCESS;
+}